@@ -73,6 +73,8 @@ std::vector<std::shared_ptr<atlas::Primitive>> createPrimitives()
 		auto &s = checkerMaterial->addShader<atlas::ConstantShader<Float>>();
 		s.value = 10;
 		t.iScale.bind(s.out);
+
+		checkerMaterial->compile();
 	}
 
 	std::shared_ptr<atlas::Material> noiseMaterial = std::make_shared<atlas::Material>();
@@ -89,6 +91,8 @@ std::vector<std::shared_ptr<atlas::Primitive>> createPrimitives()
 		auto &d = noiseMaterial->addShader<atlas::ConstantShader<uint32_t>>();
 		d.value = 1;
 		t.iDepth.bind(d.out);
+
+		noiseMaterial->compile();
 	}
 
 	std::shared_ptr<atlas::Material> imageMaterial = std::make_shared<atlas::Material>();
@@ -102,6 +106,8 @@ std::vector<std::shared_ptr<atlas::Primitive>> createPrimitives()
 		auto &c = imageMaterial->addShader<atlas::ConstantShader<atlas::Vec2f>>();
 		c.value = atlas::Vec2f(0, 0);
 		t.iOffset.bind(c.out);
+
+		imageMaterial->compile();
 	}
 
 	std::shared_ptr<atlas::Material> emissiveMaterial = std::make_shared<atlas::Material>();
@@ -115,6 +121,8 @@ std::vector<std::shared_ptr<atlas::Primitive>> createPrimitives()
 		auto &c = emissiveMaterial->addConstant<Float>();
 		c.value = 1.f;
 		l.iStrength.bind(c.out);
+
+		emissiveMaterial->compile();
 	}
 
 	atlas::SphereInfo sphereInfo;
@@ -271,14 +279,11 @@ int main()
 
 #if 0
 	// setup rendering configuration
-	atlas::StratifiedSampler sampler;
-
 	atlas::Acheron::Info achInfo;
 	achInfo.samplePerPixel = spp;
 	achInfo.minLightBounce = 0;
 	achInfo.maxLightBounce = 16;
 	achInfo.lightTreshold = (Float)0.01;
-	achInfo.sampler = &sampler;
 	achInfo.assetFolder = "./";
 	achInfo.temporaryFolder = "./render/";
 	atlas::Acheron ach(achInfo);
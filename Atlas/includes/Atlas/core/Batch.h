@@ -27,6 +27,8 @@ namespace atlas
 		Block<uint16_t> sampleIDs;
 		Block<uint16_t> depths;
 		Block<Float> tNears;
+		Block<Float> coneWidths;
+		Block<Float> coneSpreads;
 		uint32_t usedSize;
 
 		Batch() = default;
@@ -39,6 +41,8 @@ namespace atlas
 			, sampleIDs(maxSize)
 			, depths(maxSize)
 			, tNears(maxSize)
+			, coneWidths(maxSize)
+			, coneSpreads(maxSize)
 			, usedSize(maxSize)
 		{
 
@@ -58,6 +62,8 @@ namespace atlas
 			sampleIDs.resize(size);
 			depths.resize(size);
 			tNears.resize(size);
+			coneWidths.resize(size);
+			coneSpreads.resize(size);
 		}
 
 		void resize(uint32_t newSize)
@@ -75,6 +81,8 @@ namespace atlas
 			sampleIDs.clear();
 			depths.clear();
 			tNears.clear();
+			coneWidths.clear();
+			coneSpreads.clear();
 		}
 
 		void swap(uint32_t a, uint32_t b)
@@ -86,6 +94,8 @@ namespace atlas
 			std::swap(sampleIDs[a], sampleIDs[b]);
 			std::swap(depths[a], depths[b]);
 			std::swap(tNears[a], tNears[b]);
+			std::swap(coneWidths[a], coneWidths[b]);
+			std::swap(coneSpreads[a], coneSpreads[b]);
 		}
 	};
 
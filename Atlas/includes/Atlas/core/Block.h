@@ -46,6 +46,13 @@ namespace atlas
 			}
 		}
 
+		// Only grows the buffer, used for scratch memory reused between calls
+		void reserve(uint32_t size)
+		{
+			if (size > this->size())
+				resize(size);
+		}
+
 		void clear()
 		{
 			if (!isSubBlock() && buffer)
@@ -76,7 +83,7 @@ namespace atlas
 
 		uint32_t size() const
 		{
-			return (0x7FFFFFFF & bufferSize);
+			return (0x3FFFFFFF & bufferSize);
 		}
 
 		bool isSubBlock() const
@@ -98,7 +105,9 @@ namespace atlas
 		{}
 
 		DataBlock(DataBlock &block, uint32_t start, uint32_t size)
-			: Block(block, start, size)
+			: Block(block, start * block.laneCount, size * block.laneCount)
+			, laneCount(block.laneCount)
+			, lane(block.lane)
 		{}
 
 		DataBlock(const DataBlock &block) = delete; // construction from another DataBlock is forbidden to prevent data ownership issue
@@ -110,7 +119,7 @@ namespace atlas
 		void set(const T &val, uint32_t pos)
 		{
 			CHECK(pos != -1);
-			T *ptr = (T *)&buffer[pos];
+			T *ptr = (T *)&buffer[pos * laneCount + lane * sizeof(T)];
 			*ptr = val;
 		}
 
@@ -118,8 +127,51 @@ namespace atlas
 		const T &get(uint32_t pos) const
 		{
 			CHECK(pos != -1);
-			T *val = (T *)&buffer[pos];
+			T *val = (T *)&buffer[pos * laneCount + lane * sizeof(T)];
 			return (*val);
 		}
+
+		// A block can hold the data of several shading points at once. Each value is then
+		// stored as an array of laneCount elements starting at pos * laneCount, and set/get
+		// access the element of the current lane.
+		void setLaneCount(uint32_t count)
+		{
+			laneCount = count;
+			lane = 0;
+		}
+
+		void setLane(uint32_t idx)
+		{
+			DCHECK(idx < laneCount);
+			lane = idx;
+		}
+
+		uint32_t getLaneCount() const
+		{
+			return (laneCount);
+		}
+
+		uint32_t getLane() const
+		{
+			return (lane);
+		}
+
+		template <typename T>
+		T *getArray(uint32_t pos)
+		{
+			CHECK(pos != -1);
+			return ((T *)&buffer[pos * laneCount]);
+		}
+
+		template <typename T>
+		const T *getArray(uint32_t pos) const
+		{
+			CHECK(pos != -1);
+			return ((const T *)&buffer[pos * laneCount]);
+		}
+
+	private:
+		uint32_t laneCount = 1;
+		uint32_t lane = 0;
 	};
 }
\ No newline at end of file
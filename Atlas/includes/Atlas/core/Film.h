@@ -1,16 +1,28 @@
 #pragma once
 
+#include <iostream>
+
 #include "atlas/Atlas.h"
 #include "atlas/AtlasLibHeader.h"
 #include "atlas/core/Bounds.h"
 #include "atlas/core/Filter.h"
 #include "atlas/core/Points.h"
 #include "atlas/core/RgbSpectrum.h"
+#include "atlas/core/Vectors.h"
 
 namespace atlas
 {
 	class FilmIterator;
 
+	// Auxiliary channels filled with the first hit of each pixel
+	enum class AovFlags : uint32_t
+	{
+		Albedo = 1,
+		Normal = 2,
+		Depth = 4,
+		MaterialID = 8
+	};
+
 	class Film
 	{
 	public:
@@ -23,6 +35,8 @@ namespace atlas
 			std::string filename;
 			Float scale = 1;
 			Float maxSampleLuminance = INFINITY;
+			// Combination of AovFlags
+			uint32_t aovs = 0;
 		};
 
 		struct Pixel
@@ -41,6 +55,8 @@ namespace atlas
 
 		ATLAS void addSample(uint32_t pixelID, const Spectrum &L, Float sampleWeight = 1.f);
 		ATLAS void addSample(const Point2f &pFilm, const Spectrum &L, Float sampleWeight = 1.f);
+		// Splats count samples at once, sampleWeights can be null
+		ATLAS void addSamples(const Point2f *pFilm, const Spectrum *L, uint32_t count, const Float *sampleWeights = nullptr);
 
 		ATLAS Pixel &getPixel(const Point2i &p);
 		ATLAS const Pixel &getPixel(const Point2i &p) const;
@@ -55,7 +71,29 @@ namespace atlas
 			return (pixels[idx]);
 		}
 
+		inline bool hasAov(AovFlags aov) const
+		{
+			return (aovs & (uint32_t)aov);
+		}
+
+		inline bool hasAovs() const
+		{
+			return (aovs != 0);
+		}
+
+		// Channels that were not requested are ignored
+		ATLAS void setAovs(uint32_t pixelID, const Spectrum &albedo, const Normal &n, Float depth, uint32_t materialID);
+		ATLAS Spectrum getAlbedo(uint32_t pixelID) const;
+		ATLAS Normal getNormal(uint32_t pixelID) const;
+		ATLAS Float getDepth(uint32_t pixelID) const;
+		ATLAS uint32_t getMaterialID(uint32_t pixelID) const;
+		// read returns false when the stream does not hold the same channels
+		ATLAS void writeAovs(std::ostream &out) const;
+		ATLAS bool readAovs(std::istream &in);
+
 		ATLAS void writeImage(Float splatScale = 1);
+		// Normals, depths and IDs are written as they are, the format is picked from the extension
+		ATLAS void writeAov(AovFlags aov, const std::string &name) const;
 		ATLAS void clear();
 
 		const Point2i resolution;
@@ -65,11 +103,26 @@ namespace atlas
 		const Float scale;
 
 	private:
+		void splat(const Point2f &pFilm, const Spectrum &L, Float sampleWeight);
+
 		std::unique_ptr<Pixel[]> pixels;
 		std::unique_ptr<Filter> filter;
 
+		// Half floats for the albedo and the depth, octahedral normals
+		uint32_t aovs = 0;
+		std::unique_ptr<uint16_t[]> albedos;
+		std::unique_ptr<uint32_t[]> normals;
+		std::unique_ptr<uint16_t[]> depths;
+		std::unique_ptr<uint32_t[]> materialIDs;
+
 		static constexpr int filterTableWidth = 16;
+		// Widest footprint of the filter on one axis, the splat keeps its arrays on the stack
+		static constexpr int maxFootprint = 16;
 		Float filterTable[filterTableWidth * filterTableWidth];
+		// Weights of separable filters are the product of a column and a row of these tables
+		bool separableFilter = false;
+		alignas(16) Float filterTableX[filterTableWidth];
+		alignas(16) Float filterTableY[filterTableWidth];
 
 		Float maxSampleLuminance;
 	};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include <iostream>
+#include <memory>
 
 #include "atlas/Atlas.h"
 #include "atlas/core/Points.h"
@@ -11,20 +13,54 @@
 
 namespace atlas
 {
+	// Samples of an iteration go to their own buffer, merged into the pixels of the film once the
+	// iteration is done. The film always holds the image converged so far.
 	class FilmIterator
 	{
 	public:
+		// Running mean and variance of the luminance of a pixel, one value per iteration weighted by its sample count
+		struct PixelStats
+		{
+			Float mean = 0;
+			Float m2 = 0;
+			Float weight = 0;
+			uint32_t count = 0;
+		};
+
+		static constexpr uint32_t RecheckInterval = 8;
+
 		ATLAS FilmIterator(Film::Pixel *pixels, uint32_t size);
 
 		ATLAS void start(uint32_t newSampleCount);
 		ATLAS void clear(uint32_t sampleCount);
 
+		// Adds the current iteration to the film, every snapshotInterval merges the film is also saved
+		ATLAS void merge();
 		ATLAS void save();
 		ATLAS void accumulate();
 
+		// Variance of the mean luminance of a pixel, infinite until it got two iterations
+		ATLAS Float getPixelVariance(uint32_t pixelID) const;
+		// Relative standard error of the mean of a pixel
+		ATLAS Float getPixelError(uint32_t pixelID) const;
+		// Pixels with an error below the threshold after at least minIterations get no sample in the next
+		// iterations, but one every RecheckInterval. Returns the number of pixels that have not converged.
+		ATLAS uint32_t updateActivePixels(Float errorThreshold, uint32_t minIterations);
+
+		// Merged state only, to be called between two iterations. read returns false when the
+		// stream does not hold an iterator of the same size.
+		ATLAS void write(std::ostream &out) const;
+		ATLAS bool read(std::istream &in);
+
+		// 0 disables the snapshots
+		inline void setSnapshotInterval(uint32_t interval)
+		{
+			snapshotInterval = interval;
+		}
+
 		inline void addSample(const uint32_t pixelID, const Spectrum &LIn, Float sampleWeight = 1.f)
 		{
-			pixels[pixelID].color += LIn * sampleWeight;
+			iterationPixels[pixelID].color += LIn * sampleWeight;
 		}
 
 		inline uint32_t getSampleCount() const
@@ -37,10 +73,27 @@ namespace atlas
 			return (pixels[pixelID]);
 		}
 
+		// Null until updateActivePixels is called, every pixel is active
+		inline const uint8_t *getActivePixels() const
+		{
+			return (active.get());
+		}
+
+		inline uint32_t getIterationCount() const
+		{
+			return (itCount);
+		}
+
 	private:
 		uint32_t itCount = 0;
+		uint32_t mergedCount = 0;
 		uint32_t sampleCount = 0;
+		uint32_t snapshotInterval = 0;
+		bool pending = false;
 		const uint32_t size = 0;
 		Film::Pixel *pixels = nullptr;
+		std::unique_ptr<Film::Pixel[]> iterationPixels;
+		std::unique_ptr<PixelStats[]> stats;
+		std::unique_ptr<uint8_t[]> active;
 	};
 }
\ No newline at end of file
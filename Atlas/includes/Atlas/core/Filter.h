@@ -14,6 +14,18 @@ namespace atlas
             : radius(radius), invRadius(Vec2f(1 / radius.x, 1 / radius.y)) {}
         virtual Float evaluate(const Point2f &p) const = 0;
 
+        // Filters that are the product of a function of x and a function of y return true and
+        // give that function for each axis
+        virtual bool isSeparable() const
+        {
+            return (false);
+        }
+
+        virtual Float evaluateSeparable(Float v, int axis) const
+        {
+            return (1.f);
+        }
+
         const Vec2f radius;
         const Vec2f invRadius;
     };
@@ -28,5 +40,15 @@ namespace atlas
         {
             return (1.f);
         }
+
+        bool isSeparable() const override
+        {
+            return (true);
+        }
+
+        Float evaluateSeparable(Float v, int axis) const override
+        {
+            return (1.f);
+        }
     };
 }
\ No newline at end of file
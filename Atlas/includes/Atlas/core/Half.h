@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace atlas
+{
+	// IEEE 754 binary16 conversions, rounding to nearest even
+	inline uint16_t toHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+		const uint32_t absBits = bits & 0x7FFFFFFF;
+
+		if (absBits >= 0x7F800000)
+			return (sign | 0x7C00 | (absBits > 0x7F800000 ? 0x200 : 0));
+		if (absBits >= 0x477FF000)
+			return (sign | 0x7C00);
+		if (absBits < 0x38800000)
+		{
+			if (absBits < 0x33000000)
+				return (sign);
+			const uint32_t shift = 126 - (absBits >> 23);
+			const uint32_t mantissa = (absBits & 0x7FFFFF) | 0x800000;
+			const uint32_t remainder = mantissa & ((1u << shift) - 1);
+			const uint32_t halfway = 1u << (shift - 1);
+			uint32_t half = mantissa >> shift;
+			if (remainder > halfway || (remainder == halfway && (half & 1)))
+				half++;
+			return (sign | static_cast<uint16_t>(half));
+		}
+
+		uint32_t half = (absBits - 0x38000000) >> 13;
+		const uint32_t remainder = absBits & 0x1FFF;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+			half++;
+		return (sign | static_cast<uint16_t>(half));
+	}
+
+	inline float fromHalf(uint16_t value)
+	{
+		const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+		uint32_t exponent = (value >> 10) & 0x1F;
+		uint32_t mantissa = value & 0x3FF;
+
+		uint32_t bits;
+		if (exponent == 0x1F)
+			bits = sign | 0x7F800000 | (mantissa << 13);
+		else if (exponent != 0)
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		else if (mantissa == 0)
+			bits = sign;
+		else
+		{
+			exponent = 113;
+			while (!(mantissa & 0x400))
+			{
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+		}
+
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+		return (result);
+	}
+}
@@ -1,35 +1,28 @@
 #pragma once
 
 #include <string>
-#include <fstream>
 
 #include "atlas/Atlas.h"
+#include "atlas/AtlasLibHeader.h"
 #include "atlas/core/Bounds.h"
 #include "atlas/core/Points.h"
 
 namespace atlas
 {
-	inline void writeImageToFile(const std::string &name, const Float *rgb,
-		const Bounds2i &outputBounds, const Point2i &totalResolution)
+	enum class ImageFormat
 	{
-		std::ofstream file(name);
-		if (file)
-		{
-			file << "P3\n"
-				<< totalResolution.x << " " << totalResolution.y << "\n"
-				<< "255\n";
+		Ppm, // binary P6, clamped to 8 bits
+		Pfm, // 32 bit float
+		Exr // uncompressed scanlines of half floats
+	};
 
-			for (int32_t j = 0; j < totalResolution.y; ++j) // this loop check for j < _ny because when as j is unsigned -1 will be the highest value j can hold, therefore higher than _ny
-			{
-				for (int32_t i = 0; i < totalResolution.x; ++i)
-				{
-					int r = static_cast<int>(255.99 * rgb[3 * (j * totalResolution.x + i)]);
-					int g = static_cast<int>(255.99 * rgb[3 * (j * totalResolution.x + i) + 1]);
-					int b = static_cast<int>(255.99 * rgb[3 * (j * totalResolution.x + i) + 2]);
-					file << r << " " << g << " " << b << "\n";
-				}
-			}
-			file.close();
-		}
-	}
-}
\ No newline at end of file
+	// Picks the format from the extension, PPM when it is not known
+	ATLAS ImageFormat getImageFormat(const std::string &name);
+
+	// rgb holds the pixels of outputBounds only. EXR files keep totalResolution as display window,
+	// the other formats only store outputBounds.
+	ATLAS void writeImageToFile(const std::string &name, const Float *rgb,
+		const Bounds2i &outputBounds, const Point2i &totalResolution);
+	ATLAS void writeImageToFile(const std::string &name, ImageFormat format, const Float *rgb,
+		const Bounds2i &outputBounds, const Point2i &totalResolution);
+}
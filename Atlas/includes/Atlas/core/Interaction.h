@@ -143,6 +143,8 @@ namespace atlas
 			TransportMode mode = TransportMode::Radiance);
 
 		ATLAS void computeDifferentials(const RayDifferential &r) const;
+		// Same as above with the differentials derived from a ray cone
+		ATLAS void computeDifferentials(const Ray &r, Float coneWidth, Float coneSpread) const;
 
 		ATLAS Spectrum le(const Vec3f &w) const;
 	};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "atlas/Atlas.h"
+#include "atlas/AtlasLibHeader.h"
+#include "atlas/core/Points.h"
+#include "atlas/core/Random.h"
+
+namespace atlas
+{
+	static constexpr uint32_t SobolDimensions = 16;
+	static constexpr uint32_t SobolMatrixSize = 32;
+	static constexpr uint32_t PrimeTableSize = 64;
+	static constexpr uint32_t BlueNoiseTileSize = 64;
+
+	// Rank-1 lattice generators in 32 bit fixed point, 2^32 / phi and the R2 sequence
+	static constexpr uint32_t GoldenRatioLattice = 2654435769u;
+	static constexpr uint32_t R2Lattice[2] = { 3242174889u, 2447445414u };
+
+	// Generator matrices from the Joe-Kuo direction numbers, stored bit first so that the columns
+	// of four consecutive dimensions are contiguous. Each row is padded with zeros up to SobolDimensions + 4.
+	ATLAS const uint32_t *getSobolMatrices();
+	ATLAS uint32_t getPrime(uint32_t index);
+	ATLAS uint32_t getPrimeSum(uint32_t index);
+
+	// Ranks of a void-and-cluster blue noise tile, generated on first use
+	ATLAS const uint16_t *getBlueNoiseTile();
+
+	inline uint32_t reverseBits32(uint32_t n)
+	{
+		n = (n << 16) | (n >> 16);
+		n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+		n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+		n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+		n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+		return (n);
+	}
+
+	inline uint32_t mixBits32(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352d;
+		x ^= x >> 15;
+		x *= 0x846ca68b;
+		x ^= x >> 16;
+		return (x);
+	}
+
+	// Burley, "Practical Hash-based Owen Scrambling". Each bit only depends on the lower ones.
+	inline uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+	{
+		x += seed;
+		x ^= x * 0x6c50b47c;
+		x ^= x * 0xb82f1e52;
+		x ^= x * 0xc7afe638;
+		x ^= x * 0x8d22f6e6;
+		return (x);
+	}
+
+	inline uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+	{
+		return (reverseBits32(laineKarrasPermutation(reverseBits32(x), seed)));
+	}
+
+	inline uint32_t sobol(uint32_t index, uint32_t dimension)
+	{
+		const uint32_t *matrices = getSobolMatrices();
+		uint32_t x = 0;
+		for (uint32_t bit = 0; index; bit++, index >>= 1)
+		{
+			if (index & 1)
+				x ^= matrices[bit * (SobolDimensions + 4) + dimension];
+		}
+		return (x);
+	}
+
+	inline Float toUnitFloat(uint32_t x)
+	{
+		return ((Float)(x >> 8) * (Float)5.9604644775390625e-08);
+	}
+
+	// Toroidal shift of a dimension at a pixel, read from the blue noise tile at an offset that
+	// depends on the dimension. Neighbouring pixels get shifts far apart from each other.
+	inline uint32_t blueNoiseShift(int32_t x, int32_t y, uint32_t dimension)
+	{
+		const uint32_t h = mixBits32(dimension + 1);
+		const uint32_t tx = ((uint32_t)x + h) & (BlueNoiseTileSize - 1);
+		const uint32_t ty = ((uint32_t)y + (h >> 6)) & (BlueNoiseTileSize - 1);
+		return (((uint32_t)getBlueNoiseTile()[ty * BlueNoiseTileSize + tx] * 2 + 1) << 19);
+	}
+
+	// Order in which a dimension visits the points of its lattice. Without it every dimension of a pixel
+	// would be the same sequence up to a constant shift and the dimensions would be fully correlated.
+	// The index is Owen scrambled with a seed per dimension, so the first 2^k samples still take 2^k
+	// consecutive points of the lattice and every pixel visits them in the same order.
+	inline uint32_t blueNoiseIndex(uint32_t sampleIndex, uint32_t dimension)
+	{
+		return (nestedUniformScramble(sampleIndex, mixBits32(dimension ^ 0x9e3779b9)));
+	}
+
+	// Rank-1 lattice shifted per pixel, the first samples of a pixel already form a blue noise
+	// pattern on the screen and the following ones fill the dimension evenly
+	inline Float blueNoise1D(int32_t x, int32_t y, uint32_t sampleIndex, uint32_t dimension)
+	{
+		return (toUnitFloat(blueNoiseShift(x, y, dimension) + blueNoiseIndex(sampleIndex, dimension) * GoldenRatioLattice));
+	}
+
+	inline Point2f blueNoise2D(int32_t x, int32_t y, uint32_t sampleIndex, uint32_t dimension)
+	{
+		const uint32_t index = blueNoiseIndex(sampleIndex, dimension);
+		return (Point2f(toUnitFloat(blueNoiseShift(x, y, dimension) + index * R2Lattice[0]),
+			toUnitFloat(blueNoiseShift(x, y, dimension + 1) + index * R2Lattice[1])));
+	}
+
+	// Owen scrambled values of the dimensions [dimension, dimension + 4) with one seed per lane.
+	// Dimensions past SobolDimensions are filled with hashed values.
+	ATLAS void sobolOwen4(uint32_t index, uint32_t dimension, const uint32_t seeds[4], Float values[4]);
+
+	ATLAS Float radicalInverse(uint32_t baseIndex, uint64_t a);
+	ATLAS Float scrambledRadicalInverse(uint32_t baseIndex, uint64_t a, const uint16_t *perm);
+	ATLAS uint64_t inverseRadicalInverse(uint32_t base, uint64_t inverse, int nDigits);
+	ATLAS uint64_t multiplicativeInverse(int64_t a, int64_t n);
+
+	// One random digit permutation per prime base, the one of base getPrime(i) starts at getPrimeSum(i)
+	ATLAS std::vector<uint16_t> computeRadicalInversePermutations(RNG &rng);
+}
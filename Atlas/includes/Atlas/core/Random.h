@@ -84,6 +84,8 @@ namespace atlas
         }
 
     private:
+        friend class RNGStreams;
+
         uint64_t state;
         uint64_t inc;
     };
@@ -109,4 +111,31 @@ namespace atlas
         uint32_t rot = (uint32_t)(oldstate >> 59u);
         return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
     }
+
+    // Eight PCG32 streams advanced together with SSE, or AVX2 when the target supports it.
+    // Stream i gives the same integers as RNG(firstSequence + i); the arrays are filled with
+    // the streams interleaved, value j coming from stream j % StreamCount.
+    class RNGStreams
+    {
+    public:
+        static constexpr uint32_t StreamCount = 8;
+
+        RNGStreams(uint64_t firstSequence = 0)
+        {
+            setSequence(firstSequence);
+        }
+
+        ATLAS void setSequence(uint64_t firstSequence);
+
+        ATLAS void uniformUInt32(uint32_t *values, uint32_t count);
+        // 24 bits of precision, always lower than one
+        ATLAS void uniformFloat(Float *values, uint32_t count);
+        ATLAS void uniform2D(Point2f *points, uint32_t count);
+
+    private:
+        void next(uint32_t values[StreamCount]);
+
+        alignas(32) uint64_t state[StreamCount];
+        alignas(32) uint64_t inc[StreamCount];
+    };
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <limits>
+#include <memory>
 #include <vector>
 
 #include "atlas/Atlas.h"
@@ -66,6 +68,8 @@ namespace atlas
 		int current1DDimension = 0;
 		int current2DDimension = 0;
 		RNG rng;
+		// Batched generator for the sample arrays filled at the start of a pixel
+		RNGStreams streams;
 	};
 
 	class GlobalSampler : public Sampler
@@ -84,6 +88,11 @@ namespace atlas
 		virtual int64_t getIndexForSample(int64_t sampleNum) const = 0;
 		virtual Float sampleDimension(int64_t index, int dimension) const = 0;
 
+		virtual Point2f sampleDimension2D(int64_t index, int dimension) const
+		{
+			return (Point2f(sampleDimension(index, dimension), sampleDimension(index, dimension + 1)));
+		}
+
 	private:
 		int dimension = 0;
 		int64_t intervalSampleIndex = 0;
@@ -130,6 +139,105 @@ namespace atlas
 		const bool jitterSamples;
 	};
 
+	// Sobol points with Burley's hash based Owen scrambling, decorrelated per pixel. The sample
+	// indices of a pixel are shuffled too, so any power of two prefix is still well stratified.
+	class SobolSampler : public GlobalSampler
+	{
+	public:
+		struct Info
+		{
+			int64_t samplesPerPixel = 16;
+			uint32_t seed = 0;
+		};
+
+		static Sampler *create(const Info &info = Info())
+		{
+			return (new SobolSampler(info));
+		}
+
+		SobolSampler(const Info &info = Info())
+			: GlobalSampler(info.samplesPerPixel)
+			, seed(info.seed)
+		{}
+
+		ATLAS int64_t getIndexForSample(int64_t sampleNum) const override;
+		ATLAS Float sampleDimension(int64_t index, int dimension) const override;
+		ATLAS Point2f sampleDimension2D(int64_t index, int dimension) const override;
+
+		// Four consecutive dimensions evaluated at once
+		ATLAS void sampleDimensions(int64_t index, int dimension, Float values[4]) const;
+
+		ATLAS std::unique_ptr<Sampler> clone(int seed) override;
+
+	private:
+		uint32_t getPixelSeed() const;
+
+		uint32_t seed;
+	};
+
+	// Halton sequence with random digit permutations. As in pbrt the first two dimensions are
+	// scaled so that consecutive indices of a pixel map to the same pixel of the film.
+	class HaltonSampler : public GlobalSampler
+	{
+	public:
+		struct Info
+		{
+			int64_t samplesPerPixel = 16;
+			Point2i resolution = Point2i(128, 128);
+			uint32_t seed = 0;
+		};
+
+		static Sampler *create(const Info &info = Info())
+		{
+			return (new HaltonSampler(info));
+		}
+
+		ATLAS HaltonSampler(const Info &info = Info());
+
+		ATLAS int64_t getIndexForSample(int64_t sampleNum) const override;
+		ATLAS Float sampleDimension(int64_t index, int dimension) const override;
+
+		ATLAS std::unique_ptr<Sampler> clone(int seed) override;
+
+	private:
+		static constexpr int MaxResolution = 128;
+
+		std::shared_ptr<const std::vector<uint16_t>> permutations;
+		std::vector<uint32_t> permutationOffsets;
+		Point2i baseScales;
+		Point2i baseExponents;
+		int sampleStride;
+		int multInverse[2];
+		mutable Point2i pixelForOffset = Point2i(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+		mutable int64_t offsetForCurrentPixel = 0;
+	};
+
+	// Rank-1 lattice per dimension with a per pixel toroidal shift from a blue noise tile. The error
+	// at low sample counts is pushed to high frequencies, which looks cleaner for previews.
+	class BlueNoiseSampler : public GlobalSampler
+	{
+	public:
+		struct Info
+		{
+			int64_t samplesPerPixel = 16;
+		};
+
+		static Sampler *create(const Info &info = Info())
+		{
+			return (new BlueNoiseSampler(info));
+		}
+
+		BlueNoiseSampler(const Info &info = Info())
+			: GlobalSampler(info.samplesPerPixel)
+		{}
+
+		ATLAS int64_t getIndexForSample(int64_t sampleNum) const override;
+		ATLAS Float sampleDimension(int64_t index, int dimension) const override;
+		ATLAS Point2f sampleDimension2D(int64_t index, int dimension) const override;
+
+		ATLAS std::unique_ptr<Sampler> clone(int seed) override;
+	};
+
 	class TestSampler : Sampler
 	{
 	public:
@@ -172,4 +280,7 @@ namespace atlas
 	};
 
 	typedef StratifiedSampler::Info StratifiedSamplerInfo;
+	typedef SobolSampler::Info SobolSamplerInfo;
+	typedef HaltonSampler::Info HaltonSamplerInfo;
+	typedef BlueNoiseSampler::Info BlueNoiseSamplerInfo;
 }
\ No newline at end of file
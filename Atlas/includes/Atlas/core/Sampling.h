@@ -21,6 +21,9 @@ namespace atlas
 
 	ATLAS void stratifiedSample1D(Float *samp, int nSamples, RNG &rng, bool jitter);
     ATLAS void stratifiedSample2D(Point2f *samp, int nx, int ny, RNG &rng, bool jitter);
+    // Same strata, the jitter of all the samples is drawn at once
+    ATLAS void stratifiedSample1D(Float *samp, int nSamples, RNGStreams &rng, bool jitter);
+    ATLAS void stratifiedSample2D(Point2f *samp, int nx, int ny, RNGStreams &rng, bool jitter);
 
     ATLAS void latinHypercube(Float *samples, int nSamples, int nDim, RNG &rng);
 
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <smmintrin.h>
+
+#include "atlas/Atlas.h"
+#include "atlas/core/Camera.h"
+#include "atlas/core/LowDiscrepancy.h"
+#include "atlas/core/Points.h"
+
+namespace atlas
+{
+	// Sample values computed from their coordinates only. The same pixel, sample index, bounce and
+	// dimension always give the same value, whatever the thread or the order they are drawn in.
+	class StatelessSampler
+	{
+	public:
+		// Dimensions drawn at each bounce, the camera ones only for the first rays
+		enum Dimension : uint32_t
+		{
+			FilmDimension = 0,
+			TimeDimension = 2,
+			LensDimension = 3,
+			BsdfDimension = 5,
+			LightDimension = 7,
+			LightSampleDimension = 9
+		};
+
+		// mixBits32 on four lanes
+		static inline __m128i mix(__m128i x)
+		{
+			x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+			x = _mm_mullo_epi32(x, _mm_set1_epi32(0x7feb352d));
+			x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+			x = _mm_mullo_epi32(x, _mm_set1_epi32((int)0x846ca68b));
+			x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+			return (x);
+		}
+
+		static inline uint32_t hash(uint32_t pixelID, uint32_t sampleID, uint32_t depth, uint32_t dimension)
+		{
+			uint32_t h = mixBits32(pixelID + 0x9e3779b9);
+			h = mixBits32(h ^ sampleID);
+			h = mixBits32(h ^ ((depth << 16) | dimension));
+			return (h);
+		}
+
+		static inline Float get1D(uint32_t pixelID, uint32_t sampleID, uint32_t depth, uint32_t dimension)
+		{
+			return ((Float)(hash(pixelID, sampleID, depth, dimension) >> 8) * (Float)5.9604644775390625e-08);
+		}
+
+		static inline Point2f get2D(uint32_t pixelID, uint32_t sampleID, uint32_t depth, uint32_t dimension)
+		{
+			return (Point2f(get1D(pixelID, sampleID, depth, dimension), get1D(pixelID, sampleID, depth, dimension + 1)));
+		}
+
+		// Same values as get2D for a whole array of samples, four of them at a time
+		static inline void get2D(const uint32_t *pixelIDs, const uint16_t *sampleIDs, const uint16_t *depths, uint32_t dimension, uint32_t count, Point2f *points)
+		{
+			uint32_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i pixel = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixelIDs + i));
+				__m128i sample = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(sampleIDs + i)));
+				__m128i depth = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(depths + i)));
+
+				__m128i h = mix(_mm_add_epi32(pixel, _mm_set1_epi32((int)0x9e3779b9)));
+				h = mix(_mm_xor_si128(h, sample));
+				__m128i key = _mm_or_si128(_mm_slli_epi32(depth, 16), _mm_set1_epi32(dimension));
+				__m128i hx = mix(_mm_xor_si128(h, key));
+				__m128i hy = mix(_mm_xor_si128(h, _mm_add_epi32(key, _mm_set1_epi32(1))));
+
+				alignas(16) float x[4];
+				alignas(16) float y[4];
+				const __m128 scale = _mm_set1_ps(5.9604644775390625e-08f);
+				_mm_store_ps(x, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(hx, 8)), scale));
+				_mm_store_ps(y, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(hy, 8)), scale));
+				for (uint32_t j = 0; j < 4; j++)
+					points[i + j] = Point2f(x[j], y[j]);
+			}
+			for (; i < count; i++)
+				points[i] = get2D(pixelIDs[i], sampleIDs[i], depths[i], dimension);
+		}
+
+		static inline CameraSample getCameraSample(const Point2i &pixel, uint32_t pixelID, uint32_t sampleID)
+		{
+			CameraSample cs;
+			cs.pFilm = (Point2f)pixel + get2D(pixelID, sampleID, 0, FilmDimension);
+			cs.time = get1D(pixelID, sampleID, 0, TimeDimension);
+			cs.pLens = get2D(pixelID, sampleID, 0, LensDimension);
+			return (cs);
+		}
+
+		// Blue noise distribution of the same dimensions, see blueNoise2D. The pixel coordinates are
+		// needed to read the tile, filmWidth gives them back from the pixel id.
+		static inline Float getBlueNoise1D(uint32_t pixelID, uint32_t filmWidth, uint32_t sampleID, uint32_t depth, uint32_t dimension)
+		{
+			return (blueNoise1D(pixelID % filmWidth, pixelID / filmWidth, sampleID, (depth << 4) | dimension));
+		}
+
+		static inline Point2f getBlueNoise2D(uint32_t pixelID, uint32_t filmWidth, uint32_t sampleID, uint32_t depth, uint32_t dimension)
+		{
+			return (blueNoise2D(pixelID % filmWidth, pixelID / filmWidth, sampleID, (depth << 4) | dimension));
+		}
+
+		static inline CameraSample getBlueNoiseCameraSample(const Point2i &pixel, uint32_t sampleID)
+		{
+			CameraSample cs;
+			cs.pFilm = (Point2f)pixel + blueNoise2D(pixel.x, pixel.y, sampleID, FilmDimension);
+			cs.time = blueNoise1D(pixel.x, pixel.y, sampleID, TimeDimension);
+			cs.pLens = blueNoise2D(pixel.x, pixel.y, sampleID, LensDimension);
+			return (cs);
+		}
+	};
+}
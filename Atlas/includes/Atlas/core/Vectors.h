@@ -396,4 +396,34 @@ namespace atlas
 	typedef Vector3<int32_t> Vec3i;
 
 	typedef Vector3<Float> Normal;
+
+	// Unit vector folded on an octahedron, both coordinates are stored as 16 bit unorms
+	inline uint32_t encodeOctahedral(const Vec3f &v)
+	{
+		const Float invL1 = 1 / (std::abs(v.x) + std::abs(v.y) + std::abs(v.z));
+		Float x = v.x * invL1;
+		Float y = v.y * invL1;
+		if (v.z < 0)
+		{
+			const Float fx = (1 - std::abs(y)) * (x < 0 ? -1 : 1);
+			y = (1 - std::abs(x)) * (y < 0 ? -1 : 1);
+			x = fx;
+		}
+		const uint32_t ux = (uint32_t)std::round((clamp(x, -1, 1) * (Float)0.5 + (Float)0.5) * 65535);
+		const uint32_t uy = (uint32_t)std::round((clamp(y, -1, 1) * (Float)0.5 + (Float)0.5) * 65535);
+		return (ux | (uy << 16));
+	}
+
+	inline Vec3f decodeOctahedral(uint32_t encoded)
+	{
+		Vec3f v((Float)(encoded & 0xFFFF) / 65535 * 2 - 1, (Float)(encoded >> 16) / 65535 * 2 - 1, 0);
+		v.z = 1 - std::abs(v.x) - std::abs(v.y);
+		if (v.z < 0)
+		{
+			const Float x = (1 - std::abs(v.y)) * (v.x < 0 ? -1 : 1);
+			v.y = (1 - std::abs(v.x)) * (v.y < 0 ? -1 : 1);
+			v.x = x;
+		}
+		return (normalize(v));
+	}
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+
+//#ifdef _USE_SIMD
+
+#include "atlas/Atlas.h"
+#include "atlas/core/Ray.h"
+#include "atlas/core/simd/Simd.h"
+#include "atlas/primitives/GeometricPrimitive.h"
+#include "atlas/shapes/Triangle.h"
+
+namespace atlas
+{
+	// Vertices of up to four triangles of a BVH leaf, gathered component-wise
+	// when the tree is built. Unused lanes are left as degenerate triangles.
+	struct S4Triangle
+	{
+		S4Float p0[3];
+		S4Float p1[3];
+		S4Float p2[3];
+
+		uint32_t count = 0;
+		const GeometricPrimitive *primitives[4] = {};
+		const Triangle *triangles[4] = {};
+	};
+
+	// Same watertight test as Triangle::intersectBarycentric for the four lanes at once.
+	// Lanes with an edge function equal to zero are returned in fallbackMask, they
+	// need to be tested again in double precision.
+	SIMD_INLINE S4Bool intersect(const S4Triangle &tri, const Ray &ray, S4Float &t, S4Float &b0, S4Float &b1, S4Float &b2, unsigned &fallbackMask)
+	{
+		int kz = abs(ray.dir).maxDimension();
+		int kx = kz + 1;
+		if (kx == 3) kx = 0;
+		int ky = kx + 1;
+		if (ky == 3) ky = 0;
+		Vec3f d = permute(ray.dir, kx, ky, kz);
+		S4Float sx(-d.x / d.z);
+		S4Float sy(-d.y / d.z);
+		S4Float sz(1.f / d.z);
+
+		S4Float ox(ray.origin[kx]);
+		S4Float oy(ray.origin[ky]);
+		S4Float oz(ray.origin[kz]);
+
+		S4Float p0z = tri.p0[kz] - oz;
+		S4Float p1z = tri.p1[kz] - oz;
+		S4Float p2z = tri.p2[kz] - oz;
+		S4Float p0x = tri.p0[kx] - ox + sx * p0z;
+		S4Float p0y = tri.p0[ky] - oy + sy * p0z;
+		S4Float p1x = tri.p1[kx] - ox + sx * p1z;
+		S4Float p1y = tri.p1[ky] - oy + sy * p1z;
+		S4Float p2x = tri.p2[kx] - ox + sx * p2z;
+		S4Float p2y = tri.p2[ky] - oy + sy * p2z;
+
+		S4Float e0 = p1x * p2y - p1y * p2x;
+		S4Float e1 = p2x * p0y - p2y * p0x;
+		S4Float e2 = p0x * p1y - p0y * p1x;
+
+		S4Float zero(0.f);
+		fallbackMask = mask((e0 == zero) | (e1 == zero) | (e2 == zero)) & ((1u << tri.count) - 1);
+
+		S4Bool anyNegative = (e0 < zero) | (e1 < zero) | (e2 < zero);
+		S4Bool anyPositive = (e0 > zero) | (e1 > zero) | (e2 > zero);
+		S4Float det = e0 + e1 + e2;
+
+		p0z = p0z * sz;
+		p1z = p1z * sz;
+		p2z = p2z * sz;
+		S4Float tScaled = e0 * p0z + e1 * p1z + e2 * p2z;
+		S4Float tmaxDet = S4Float(ray.tmax) * det;
+		S4Bool inRange = ((det < zero) & (tScaled < zero) & (tScaled >= tmaxDet))
+			| ((det > zero) & (tScaled > zero) & (tScaled <= tmaxDet));
+		S4Bool valid = andNot(anyNegative & anyPositive, inRange);
+		if (!any(valid))
+			return (valid);
+
+		S4Float invDet = S4Float(1.f) / det;
+		b0 = e0 * invDet;
+		b1 = e1 * invDet;
+		b2 = e2 * invDet;
+		t = tScaled * invDet;
+
+		// Conservative error bounds on t, see Triangle::intersectBarycentric
+		S4Float maxZt = max(max(abs(p0z), abs(p1z)), abs(p2z));
+		S4Float deltaZ = S4Float(gamma(3)) * maxZt;
+		S4Float maxXt = max(max(abs(p0x), abs(p1x)), abs(p2x));
+		S4Float maxYt = max(max(abs(p0y), abs(p1y)), abs(p2y));
+		S4Float deltaX = S4Float(gamma(5)) * (maxXt + maxZt);
+		S4Float deltaY = S4Float(gamma(5)) * (maxYt + maxZt);
+		S4Float deltaE = S4Float(2.f) * (S4Float(gamma(2)) * maxXt * maxYt + deltaY * maxXt + deltaX * maxYt);
+		S4Float maxE = max(max(abs(e0), abs(e1)), abs(e2));
+		S4Float deltaT = S4Float(3.f) * (S4Float(gamma(3)) * maxE * maxZt + deltaE * maxZt + deltaZ * maxE) * abs(invDet);
+		return (valid & (t > deltaT));
+	}
+
+	// Returns the lane of the closest triangle hit before ray.tmax, or -1 if none was hit
+	inline int32_t intersectClosest(const S4Triangle &tri, const Ray &ray, Float &tHit, Float &b0, Float &b1, Float &b2)
+	{
+		S4Float t(0.f), sb0(0.f), sb1(0.f), sb2(0.f);
+		unsigned fallbackMask = 0;
+		unsigned hitMask = mask(intersect(tri, ray, t, sb0, sb1, sb2, fallbackMask)) & ~fallbackMask;
+		if (!hitMask && !fallbackMask)
+			return (-1);
+
+		alignas(16) float ts[4], b0s[4], b1s[4], b2s[4];
+		_mm_store_ps(ts, t.m);
+		_mm_store_ps(b0s, sb0.m);
+		_mm_store_ps(b1s, sb1.m);
+		_mm_store_ps(b2s, sb2.m);
+
+		int32_t closest = -1;
+		tHit = ray.tmax;
+		for (uint32_t i = 0; i < tri.count; i++)
+		{
+			if (fallbackMask & (1 << i))
+			{
+				Float ft, fb0, fb1, fb2;
+				if (tri.triangles[i]->intersectBarycentric(ray, ft, fb0, fb1, fb2) && ft < tHit)
+				{
+					closest = i;
+					tHit = ft;
+					b0 = fb0;
+					b1 = fb1;
+					b2 = fb2;
+				}
+			}
+			else if ((hitMask & (1 << i)) && ts[i] < tHit)
+			{
+				closest = i;
+				tHit = ts[i];
+				b0 = b0s[i];
+				b1 = b1s[i];
+				b2 = b2s[i];
+			}
+		}
+		return (closest);
+	}
+
+	inline bool intersectAny(const S4Triangle &tri, const Ray &ray)
+	{
+		S4Float t, b0, b1, b2;
+		unsigned fallbackMask = 0;
+		if (mask(intersect(tri, ray, t, b0, b1, b2, fallbackMask)) & ~fallbackMask)
+			return (true);
+
+		for (uint32_t i = 0; i < tri.count; i++)
+		{
+			if ((fallbackMask & (1 << i)) && tri.triangles[i]->intersectP(ray))
+				return (true);
+		}
+		return (false);
+	}
+}
+
+//#endif
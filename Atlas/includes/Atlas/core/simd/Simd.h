@@ -105,6 +105,21 @@ namespace atlas
 		return (S4Float(_mm_max_ps(a.m, b.m)));
 	}
 
+	SIMD_INLINE S4Float abs(S4Float a)
+	{
+		return (S4Float(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.m)));
+	}
+
+	SIMD_INLINE S4Float andNot(S4Float a, S4Float b)
+	{
+		return (S4Float(_mm_andnot_ps(a.m, b.m)));
+	}
+
+	SIMD_INLINE S4Float floor(S4Float a)
+	{
+		return (S4Float(_mm_floor_ps(a.m)));
+	}
+
 #define SHUFFLE4(V, X, Y, Z, W) S4Float(_mm_shuffle_ps((V).m, (V).m, _MM_SHUFFLE(W, Z, Y, X)))
 
 	typedef S4Float S4Bool;
@@ -5,6 +5,7 @@
 
 #include "atlas/AtlasLibHeader.h"
 #include "atlas/primitives/Aggregate.h"
+#include "atlas/core/simd/STriangle.h"
 
 namespace atlas
 {
@@ -16,6 +17,7 @@ namespace atlas
 	{
 	public:
         ATLAS BvhAccel(const std::vector<std::shared_ptr<Primitive>> &p);
+        ATLAS ~BvhAccel();
 
         ATLAS bool intersect(const Ray &r, SurfaceInteraction &) const override;
         ATLAS bool intersectP(const Ray &r) const override;
@@ -38,9 +40,13 @@ namespace atlas
     private:
         std::vector<std::shared_ptr<Primitive>> primitives;
         LinearBvhNode *nodes = nullptr;
+        // Filled only when the 4-wide kernel is built, the layout of the class does not depend on it
+        std::vector<S4Triangle> trianglePacks;
 
         ATLAS BvhBuildNode *recursiveBuild(std::vector<BvhPrimitiveInfo> &primitiveInfo, int32_t start, int32_t end, int32_t &totalNodes,
                                             std::vector<std::shared_ptr<Primitive>> &orderedPrims);
-        ATLAS int32_t flattenBvhTree(BvhBuildNode *node, int32_t &offset);
+        ATLAS int32_t flattenBvhTree(BvhBuildNode *root, std::vector<std::shared_ptr<Primitive>> &orderedPrims, std::vector<LinearBvhNode> &linearNodes);
+        ATLAS bool writeLinearNode(const BvhBuildNode *node, LinearBvhNode *linearNode, std::vector<std::shared_ptr<Primitive>> &orderedPrims);
+        ATLAS void packTriangles(LinearBvhNode *leaf, const std::shared_ptr<Primitive> *leafPrimitives);
 	};
 }
\ No newline at end of file
@@ -51,6 +51,11 @@ namespace atlas
 
         ATLAS void computeScatteringFunctions(SurfaceInteraction &isect, TransportMode mode, bool allowMultipleLobes) const override;
 
+        // Fills the primitive related fields of an interaction already computed by the shape
+        ATLAS void completeInteraction(const Ray &r, SurfaceInteraction &intersection) const;
+
+        const Shape *getShape() const { return (shape.get()); }
+
     private:
         std::shared_ptr<Shape> shape;
         std::shared_ptr<Material> material;
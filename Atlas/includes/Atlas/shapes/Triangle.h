@@ -22,6 +22,16 @@ namespace atlas
         ATLAS Float area() const override;
         ATLAS Interaction sample(const Point2f &u, Float &pdf) const override;
 
+        // Watertight test only, the interaction is filled separately once the closest hit is known
+        ATLAS bool intersectBarycentric(const Ray &ray, Float &t, Float &b0, Float &b1, Float &b2) const;
+        ATLAS bool computeInteraction(const Ray &ray, Float b0, Float b1, Float b2, SurfaceInteraction &isect) const;
+
+        inline void getVertices(Point3f &p0, Point3f &p1, Point3f &p2) const
+        {
+            p0 = mesh->p[v[0]];
+            p1 = mesh->p[v[1]];
+            p2 = mesh->p[v[2]];
+        }
 	private:
 		std::shared_ptr<TriangleMesh> mesh;
 		const uint32_t *v;
@@ -1,5 +1,8 @@
 #include "atlas/primitives/BvhAccel.h"
 
+#include <deque>
+#include <malloc.h>
+
 #include "atlas/core/Bounds.h"
 #include "atlas/core/Points.h"
 #include "atlas/core/ConeBoxIntersection.h"
@@ -41,26 +44,32 @@ namespace atlas
 			bounds = expand(c0->bounds, c1->bounds);
 			splitAxis = axis;
 			nPrimitives = 0;
+			nodeCount = 1 + c0->nodeCount + c1->nodeCount;
 		}
 
 		int32_t splitAxis = 0;
 		int32_t firstPrimOffset = 0;
 		int32_t nPrimitives = 0;
+		// Nodes of the subtree, this one included
+		int32_t nodeCount = 1;
 		Bounds3f bounds;
 		BvhBuildNode *children[2] = {nullptr, nullptr};
 	};
 
+	// Children of an interior node are always stored side by side at childOffset and childOffset + 1
 	struct LinearBvhNode
 	{
 		Bounds3f bounds;
 		union
 		{
 			int32_t primitiveOffset = 0;
-			int32_t secondChildOffset;
+			int32_t childOffset;
 		};
 		uint16_t nPrimitives = 0;
 		uint8_t axis = 0;
+		uint8_t packed = 0;
 	};
+	static_assert(sizeof(LinearBvhNode) == 32, "A sibling pair of LinearBvhNode should fill one cache line");
 
 	struct BucketInfo
 	{
@@ -69,6 +78,18 @@ namespace atlas
 	};
 }
 
+namespace
+{
+	constexpr int32_t pageSize = 4096;
+#ifdef _USE_SIMD
+	// Leaves of up to four triangles are tested at once by the 4-wide kernel
+	constexpr int32_t maxPrimsInNode = 4;
+#else
+	constexpr int32_t maxPrimsInNode = 2;
+#endif
+	constexpr int32_t treeletSize = pageSize / sizeof(LinearBvhNode);
+}
+
 BvhAccel::BvhAccel(const std::vector<std::shared_ptr<Primitive>> &p)
 	: primitives(p)
 {
@@ -86,10 +107,23 @@ BvhAccel::BvhAccel(const std::vector<std::shared_ptr<Primitive>> &p)
 	primitives.swap(orderedPrims);
 	primitiveInfo.resize(0);
 
-	int32_t offset = 0;
-	nodes = new LinearBvhNode[totalNodes];
-	flattenBvhTree(root, offset);
-	CHECK(totalNodes == offset);
+	orderedPrims.clear();
+	orderedPrims.reserve(primitives.size());
+	std::vector<LinearBvhNode> linearNodes;
+	linearNodes.reserve(totalNodes + 1);
+	int32_t nodeCount = flattenBvhTree(root, orderedPrims, linearNodes);
+	CHECK(nodeCount >= totalNodes + 1);
+	CHECK(orderedPrims.size() == primitives.size());
+	primitives.swap(orderedPrims);
+
+	// The treelets are laid out relative to the start of the array, it has to start on a page
+	nodes = static_cast<LinearBvhNode *>(_aligned_malloc(sizeof(LinearBvhNode) * nodeCount, pageSize));
+	std::uninitialized_copy(linearNodes.begin(), linearNodes.end(), nodes);
+}
+
+BvhAccel::~BvhAccel()
+{
+	_aligned_free(nodes);
 }
 
 BvhBuildNode *BvhAccel::recursiveBuild(std::vector<BvhPrimitiveInfo> &primitiveInfo,
@@ -199,7 +233,7 @@ BvhBuildNode *BvhAccel::recursiveBuild(std::vector<BvhPrimitiveInfo> &primitiveI
 				// Either create leaf or split primitives at selected SAH
 				// bucket
 				Float leafCost = static_cast<Float>(nPrimitives);
-				if (nPrimitives > 2 || minCost < leafCost) {
+				if (nPrimitives > maxPrimsInNode || minCost < leafCost) {
 					BvhPrimitiveInfo *pmid = std::partition(
 						&primitiveInfo[start], &primitiveInfo[end - 1] + 1,
 						[=](const BvhPrimitiveInfo &pi) {
@@ -231,25 +265,135 @@ BvhBuildNode *BvhAccel::recursiveBuild(std::vector<BvhPrimitiveInfo> &primitiveI
 	return node;
 }
 
-int32_t BvhAccel::flattenBvhTree(BvhBuildNode *node, int32_t &offset)
+bool BvhAccel::writeLinearNode(const BvhBuildNode *node, LinearBvhNode *linearNode, std::vector<std::shared_ptr<Primitive>> &orderedPrims)
 {
-	LinearBvhNode *linearNode = &nodes[offset];
 	linearNode->bounds = node->bounds;
-	int32_t myOffset = offset++;
 	if (node->nPrimitives > 0)
 	{
 		CHECK(!node->children[0] && !node->children[1]);
-		linearNode->primitiveOffset = node->firstPrimOffset;
+		linearNode->primitiveOffset = static_cast<int32_t>(orderedPrims.size());
 		linearNode->nPrimitives = node->nPrimitives;
+		for (int32_t i = 0; i < node->nPrimitives; i++)
+			orderedPrims.push_back(primitives[node->firstPrimOffset + i]);
+#ifdef _USE_SIMD
+		packTriangles(linearNode, &orderedPrims[linearNode->primitiveOffset]);
+#endif
+		return (false);
+	}
+	linearNode->axis = node->splitAxis;
+	linearNode->nPrimitives = 0;
+	return (true);
+}
+
+void BvhAccel::packTriangles(LinearBvhNode *leaf, const std::shared_ptr<Primitive> *leafPrimitives)
+{
+	// Only leaves made exclusively of triangles are gathered for the 4-wide kernel. A degenerate
+	// triangle has no interaction, it would only be rejected once the traversal is over, so leaves
+	// holding one are left to the scalar test which never reports it as a hit.
+	const GeometricPrimitive *geometric[maxPrimsInNode];
+	const Triangle *triangles[maxPrimsInNode];
+	if (leaf->nPrimitives > maxPrimsInNode)
+		return;
+	for (int32_t i = 0; i < leaf->nPrimitives; i++)
+	{
+		geometric[i] = dynamic_cast<const GeometricPrimitive *>(leafPrimitives[i].get());
+		triangles[i] = geometric[i] ? dynamic_cast<const Triangle *>(geometric[i]->getShape()) : nullptr;
+		if (!triangles[i])
+			return;
+
+		Point3f p0, p1, p2;
+		triangles[i]->getVertices(p0, p1, p2);
+		if (cross(p2 - p0, p1 - p0).lengthSquared() == 0)
+			return;
 	}
-	else
+
+	alignas(16) float p[3][3][4] = {};
+	S4Triangle pack;
+	pack.count = leaf->nPrimitives;
+	for (uint32_t i = 0; i < pack.count; i++)
+	{
+		Point3f v[3];
+		triangles[i]->getVertices(v[0], v[1], v[2]);
+		for (int32_t j = 0; j < 3; j++)
+		{
+			p[j][0][i] = v[j].x;
+			p[j][1][i] = v[j].y;
+			p[j][2][i] = v[j].z;
+		}
+		pack.primitives[i] = geometric[i];
+		pack.triangles[i] = triangles[i];
+	}
+	for (int32_t axis = 0; axis < 3; axis++)
+	{
+		pack.p0[axis] = S4Float(p[0][axis]);
+		pack.p1[axis] = S4Float(p[1][axis]);
+		pack.p2[axis] = S4Float(p[2][axis]);
+	}
+
+	leaf->packed = 1;
+	leaf->primitiveOffset = static_cast<int32_t>(trianglePacks.size());
+	trianglePacks.push_back(pack);
+}
+
+int32_t BvhAccel::flattenBvhTree(BvhBuildNode *root, std::vector<std::shared_ptr<Primitive>> &orderedPrims, std::vector<LinearBvhNode> &linearNodes)
+{
+	// Nodes are laid out in treelets filled breadth-first, so the top levels of any subtree
+	// share the same page. A treelet never crosses a page: it takes what is left of the current
+	// one, or starts on the next page when too little is left, the gap being padded. The root
+	// is followed by a padding node so that every sibling pair starts on a cache line. Leaves
+	// hand out their primitives in the same order, which keeps the primitives visited together
+	// close in memory as well.
+	struct PendingNode
+	{
+		BvhBuildNode *node;
+		int32_t offset;
+	};
+
+	linearNodes.resize(2);
+	std::deque<PendingNode> treeletRoots;
+	if (writeLinearNode(root, &linearNodes[0], orderedPrims))
+		treeletRoots.push_back({ root, 0 });
+
+	int32_t offset = 2;
+	std::deque<PendingNode> queue;
+	while (!treeletRoots.empty())
 	{
-		linearNode->axis = node->splitAxis;
-		linearNode->nPrimitives = 0;
-		flattenBvhTree(node->children[0], offset);
-		linearNode->secondChildOffset = flattenBvhTree(node->children[1], offset);
+		queue.push_back(treeletRoots.front());
+		treeletRoots.pop_front();
+
+		// The nodes below the treelet root, it is itself stored with its sibling in the parent treelet
+		const int32_t needed = std::min(queue.front().node->nodeCount - 1, treeletSize);
+		int32_t remaining = treeletSize - offset % treeletSize;
+		if (needed > remaining && remaining < treeletSize / 4)
+		{
+			offset += remaining;
+			remaining = treeletSize;
+		}
+		const int32_t treeletEnd = offset + std::min(needed, remaining);
+		while (!queue.empty())
+		{
+			PendingNode current = queue.front();
+			queue.pop_front();
+
+			if (offset + 2 > treeletEnd)
+			{
+				treeletRoots.push_back(current);
+				continue;
+			}
+
+			int32_t childOffset = offset;
+			offset += 2;
+			linearNodes.resize(offset);
+			linearNodes[current.offset].childOffset = childOffset;
+			for (int32_t i = 0; i < 2; i++)
+			{
+				BvhBuildNode *child = current.node->children[i];
+				if (writeLinearNode(child, &linearNodes[childOffset + i], orderedPrims))
+					queue.push_back({ child, childOffset + i });
+			}
+		}
 	}
-	return (myOffset);
+	return (static_cast<int32_t>(linearNodes.size()));
 }
 
 bool BvhAccel::intersect(const Ray &r, SurfaceInteraction &intersection) const
@@ -261,6 +405,12 @@ bool BvhAccel::intersect(const Ray &r, SurfaceInteraction &intersection) const
 	Vec3f invDir(1.f / r.dir.x, 1.f / r.dir.y, 1.f / r.dir.z);
 	int8_t dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
 
+#ifdef _USE_SIMD
+	const S4Triangle *closestPack = nullptr;
+	int32_t closestLane = 0;
+	Float b0 = 0, b1 = 0, b2 = 0;
+#endif
+
 	int32_t toVisitOffset = 0;
 	int32_t currentNodeIndex = 0;
 	int32_t nodesToVisit[64];
@@ -271,10 +421,32 @@ bool BvhAccel::intersect(const Ray &r, SurfaceInteraction &intersection) const
 		{
 			if (node->nPrimitives > 0)
 			{
+#ifdef _USE_SIMD
+				if (node->packed)
+				{
+					// Only t and the barycentrics are kept, the interaction is filled once at the end
+					const S4Triangle &pack = trianglePacks[node->primitiveOffset];
+					Float tHit;
+					int32_t lane = intersectClosest(pack, r, tHit, b0, b1, b2);
+					if (lane >= 0)
+					{
+						r.tmax = tHit;
+						closestPack = &pack;
+						closestLane = lane;
+						hit = true;
+					}
+				}
+				else
+#endif
 				for (int32_t i = 0; i < node->nPrimitives; i++)
 				{
 					if (primitives[node->primitiveOffset + i]->intersect(r, intersection))
+					{
 						hit = true;
+#ifdef _USE_SIMD
+						closestPack = nullptr;
+#endif
+					}
 				}
 				if (toVisitOffset == 0)
 					break;
@@ -289,13 +461,13 @@ bool BvhAccel::intersect(const Ray &r, SurfaceInteraction &intersection) const
 			{
 				if (dirIsNeg[node->axis])
 				{
-					nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
-					currentNodeIndex = node->secondChildOffset;
+					nodesToVisit[toVisitOffset++] = node->childOffset;
+					currentNodeIndex = node->childOffset + 1;
 				}
 				else
 				{
-					nodesToVisit[toVisitOffset++] = node->secondChildOffset;
-					currentNodeIndex = currentNodeIndex + 1;
+					nodesToVisit[toVisitOffset++] = node->childOffset + 1;
+					currentNodeIndex = node->childOffset;
 				}
 			}
 		}
@@ -311,6 +483,16 @@ bool BvhAccel::intersect(const Ray &r, SurfaceInteraction &intersection) const
 #endif
 		}
 	}
+
+#ifdef _USE_SIMD
+	// Packed triangles are never degenerate, their interaction is always valid
+	if (closestPack)
+	{
+		const bool valid = closestPack->triangles[closestLane]->computeInteraction(r, b0, b1, b2, intersection);
+		DCHECK(valid);
+		closestPack->primitives[closestLane]->completeInteraction(r, intersection);
+	}
+#endif
 	return (hit);
 }
 
@@ -330,6 +512,14 @@ bool BvhAccel::intersectP(const Ray &r) const
 		{
 			if (node->nPrimitives > 0)
 			{
+#ifdef _USE_SIMD
+				if (node->packed)
+				{
+					if (intersectAny(trianglePacks[node->primitiveOffset], r))
+						return (true);
+				}
+				else
+#endif
 				for (int32_t i = 0; i < node->nPrimitives; i++)
 				{
 					if (primitives[node->primitiveOffset + i]->intersectP(r))
@@ -349,13 +539,13 @@ bool BvhAccel::intersectP(const Ray &r) const
 			{
 				if (dirIsNeg[node->axis])
 				{
-					nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
-					currentNodeIndex = node->secondChildOffset;
+					nodesToVisit[toVisitOffset++] = node->childOffset;
+					currentNodeIndex = node->childOffset + 1;
 				}
 				else
 				{
-					nodesToVisit[toVisitOffset++] = node->secondChildOffset;
-					currentNodeIndex = currentNodeIndex + 1;
+					nodesToVisit[toVisitOffset++] = node->childOffset + 1;
+					currentNodeIndex = node->childOffset;
 				}
 			}
 		}
@@ -390,6 +580,15 @@ void BvhAccel::intersect(const Payload &p, std::vector<SurfaceInteraction> &it,
 		{
 			if (node->nPrimitives > 0)
 			{
+#ifdef _USE_SIMD
+				if (node->packed)
+				{
+					const S4Triangle &pack = trianglePacks[node->primitiveOffset];
+					for (uint32_t i = 0; i < pack.count; i++)
+						pack.primitives[i]->intersect(p, it, tmax);
+				}
+				else
+#endif
 				for (int32_t i = 0; i < node->nPrimitives; i++)
 				{
 					primitives[node->primitiveOffset + i]->intersect(p, it, tmax);
@@ -407,13 +606,13 @@ void BvhAccel::intersect(const Payload &p, std::vector<SurfaceInteraction> &it,
 			{
 				if (dirIsNeg[node->axis])
 				{
-					nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
-					currentNodeIndex = node->secondChildOffset;
+					nodesToVisit[toVisitOffset++] = node->childOffset;
+					currentNodeIndex = node->childOffset + 1;
 				}
 				else
 				{
-					nodesToVisit[toVisitOffset++] = node->secondChildOffset;
-					currentNodeIndex = currentNodeIndex + 1;
+					nodesToVisit[toVisitOffset++] = node->childOffset + 1;
+					currentNodeIndex = node->childOffset;
 				}
 			}
 		}
@@ -1,12 +1,18 @@
 #include "atlas/core/Film.h"
 
 #include <memory>
+#include <xmmintrin.h>
 
-#include "atlas/core/ImageIO.h"
 #include "atlas/core/FilmIterator.h"
+#include "atlas/core/Half.h"
+#include "atlas/core/ImageIO.h"
 
 using namespace atlas;
 
+#ifndef ATLAS_USE_DOUBLE_AS_FLOAT
+static_assert(sizeof(Film::Pixel) == 4 * sizeof(float), "the splat updates a pixel as a single __m128");
+#endif
+
 Film::Film(const Film::Info &info)
 	: resolution(info.resolution)
 	, croppedPixelBounds(Point2i(std::ceil(info.resolution.x *info.cropWindow.min.x), std::ceil(info.resolution.y *info.cropWindow.min.y)),
@@ -16,8 +22,18 @@ Film::Film(const Film::Info &info)
 	, filename(info.filename)
     , filter(info.filter)
     , maxSampleLuminance(info.maxSampleLuminance)
+    , aovs(info.aovs)
 {
-    pixels = std::unique_ptr<Pixel[]>(new Pixel[croppedPixelBounds.surfaceArea()]);
+    const uint32_t pixelCount = croppedPixelBounds.surfaceArea();
+    pixels = std::unique_ptr<Pixel[]>(new Pixel[pixelCount]);
+    if (hasAov(AovFlags::Albedo))
+        albedos.reset(new uint16_t[3 * pixelCount]);
+    if (hasAov(AovFlags::Normal))
+        normals.reset(new uint32_t[pixelCount]);
+    if (hasAov(AovFlags::Depth))
+        depths.reset(new uint16_t[pixelCount]);
+    if (hasAov(AovFlags::MaterialID))
+        materialIDs.reset(new uint32_t[pixelCount]);
     clear();
 
     int offset = 0;
@@ -29,6 +45,17 @@ Film::Film(const Film::Info &info)
             filterTable[offset] = filter->evaluate(p);
         }
     }
+
+    CHECK(2 * filter->radius.x + 1 <= maxFootprint && 2 * filter->radius.y + 1 <= maxFootprint);
+    separableFilter = filter->isSeparable();
+    if (separableFilter)
+    {
+        for (int i = 0; i < filterTableWidth; ++i)
+        {
+            filterTableX[i] = filter->evaluateSeparable((i + 0.5f) * filter->radius.x / filterTableWidth, 0);
+            filterTableY[i] = filter->evaluateSeparable((i + 0.5f) * filter->radius.y / filterTableWidth, 1);
+        }
+    }
 }
 
 Bounds2i Film::getSampleBounds() const
@@ -64,6 +91,17 @@ void Film::addSample(const uint32_t pixelID, const Spectrum &LIn, Float sampleWe
 }
 
 void Film::addSample(const Point2f &pFilm, const Spectrum &LIn, Float sampleWeight)
+{
+    splat(pFilm, LIn, sampleWeight);
+}
+
+void Film::addSamples(const Point2f *pFilm, const Spectrum *L, uint32_t count, const Float *sampleWeights)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        splat(pFilm[i], L[i], sampleWeights ? sampleWeights[i] : 1.f);
+}
+
+inline void Film::splat(const Point2f &pFilm, const Spectrum &LIn, Float sampleWeight)
 {
     Spectrum L = LIn;
     if (L.y() > maxSampleLuminance)
@@ -74,36 +112,70 @@ void Film::addSample(const Point2f &pFilm, const Spectrum &LIn, Float sampleWeig
     Point2i p1 = (Point2i)floor(pFilmDiscrete + filter->radius) + Point2i(1, 1);
     p0 = max(p0, croppedPixelBounds.min);
     p1 = min(p1, croppedPixelBounds.max);
+    const int width = p1.x - p0.x;
+    const int height = p1.y - p0.y;
+    if (width <= 0 || height <= 0)
+        return;
+    DCHECK(width <= maxFootprint && height <= maxFootprint);
+
+    int ifx[maxFootprint];
+    for (int x = 0; x < width; ++x)
+    {
+        Float fx = std::abs((p0.x + x - pFilmDiscrete.x) * filter->invRadius.x * filterTableWidth);
+        ifx[x] = std::min((int)std::floor(fx), filterTableWidth - 1);
+    }
 
-    int *ifx = new int[p1.x - p0.x];
-    for (int x = p0.x; x < p1.x; ++x)
+    int ify[maxFootprint];
+    for (int y = 0; y < height; ++y)
     {
-        Float fx = std::abs((x - pFilmDiscrete.x) * filter->invRadius.x * filterTableWidth);
-        ifx[x - p0.x] = std::min((int)std::floor(fx), filterTableWidth - 1);
+        Float fy = std::abs((p0.y + y - pFilmDiscrete.y) * filter->invRadius.y * filterTableWidth);
+        ify[y] = std::min((int)std::floor(fy), filterTableWidth - 1);
     }
 
-    int *ify = new int[p1.y - p0.y];
-    for (int y = p0.y; y < p1.y; ++y)
+    alignas(16) Float columnWeights[maxFootprint] = {};
+    if (separableFilter)
     {
-        Float fy = std::abs((y - pFilmDiscrete.y) * filter->invRadius.y * filterTableWidth);
-        ify[y - p0.y] = std::min((int)std::floor(fy), filterTableWidth - 1);
+        for (int x = 0; x < width; ++x)
+            columnWeights[x] = filterTableX[ifx[x]];
     }
 
-    for (int y = p0.y; y < p1.y; ++y)
+    const int pixelWidth = croppedPixelBounds.max.x - croppedPixelBounds.min.x;
+    Pixel *row = &pixels[(p0.x - croppedPixelBounds.min.x) + (p0.y - croppedPixelBounds.min.y) * pixelWidth];
+#ifndef ATLAS_USE_DOUBLE_AS_FLOAT
+    const __m128 radiance = _mm_set_ps(1.f, L.b * sampleWeight, L.g * sampleWeight, L.r * sampleWeight);
+#endif
+    for (int y = 0; y < height; ++y, row += pixelWidth)
     {
-        for (int x = p0.x; x < p1.x; ++x)
+        alignas(16) Float weights[maxFootprint];
+        if (separableFilter)
+        {
+#ifndef ATLAS_USE_DOUBLE_AS_FLOAT
+            const __m128 rowWeight = _mm_set1_ps(filterTableY[ify[y]]);
+            for (int x = 0; x < width; x += 4)
+                _mm_store_ps(weights + x, _mm_mul_ps(_mm_load_ps(columnWeights + x), rowWeight));
+#else
+            for (int x = 0; x < width; ++x)
+                weights[x] = columnWeights[x] * filterTableY[ify[y]];
+#endif
+        }
+        else
         {
-            int offset = ify[y - p0.y] * filterTableWidth + ifx[x - p0.x];
-            Float filterWeight = filterTable[offset];
+            for (int x = 0; x < width; ++x)
+                weights[x] = filterTable[ify[y] * filterTableWidth + ifx[x]];
+        }
 
-            Pixel &pixel = getPixel(Point2i(x, y));
-            pixel.color += L * sampleWeight * filterWeight;
-            pixel.filterWeightSum += filterWeight;
+        for (int x = 0; x < width; ++x)
+        {
+#ifndef ATLAS_USE_DOUBLE_AS_FLOAT
+            // A pixel is four floats, its color and its weight sum take a single multiply-add
+            float *pixel = reinterpret_cast<float *>(&row[x]);
+            _mm_storeu_ps(pixel, _mm_add_ps(_mm_loadu_ps(pixel), _mm_mul_ps(radiance, _mm_set1_ps(weights[x]))));
+#else
+            row[x].color += L * sampleWeight * weights[x];
+            row[x].filterWeightSum += weights[x];
+#endif
         }
     }
-
-    delete[] ifx;
-    delete[] ify;
 }
 
 Film::Pixel &Film::getPixel(const Point2i &p)
@@ -120,6 +192,79 @@ const Film::Pixel &Film::getPixel(const Point2i &p) const
     return pixels[offset];
 }
 
+void Film::setAovs(uint32_t pixelID, const Spectrum &albedo, const Normal &n, Float depth, uint32_t materialID)
+{
+    if (albedos)
+    {
+        albedos[3 * pixelID] = toHalf((float)albedo.r);
+        albedos[3 * pixelID + 1] = toHalf((float)albedo.g);
+        albedos[3 * pixelID + 2] = toHalf((float)albedo.b);
+    }
+    if (normals)
+        normals[pixelID] = encodeOctahedral(n);
+    if (depths)
+        depths[pixelID] = toHalf((float)depth);
+    if (materialIDs)
+        materialIDs[pixelID] = materialID;
+}
+
+Spectrum Film::getAlbedo(uint32_t pixelID) const
+{
+    DCHECK(albedos);
+    return (Spectrum(fromHalf(albedos[3 * pixelID]), fromHalf(albedos[3 * pixelID + 1]), fromHalf(albedos[3 * pixelID + 2])));
+}
+
+Normal Film::getNormal(uint32_t pixelID) const
+{
+    DCHECK(normals);
+    return (decodeOctahedral(normals[pixelID]));
+}
+
+Float Film::getDepth(uint32_t pixelID) const
+{
+    DCHECK(depths);
+    return (fromHalf(depths[pixelID]));
+}
+
+uint32_t Film::getMaterialID(uint32_t pixelID) const
+{
+    DCHECK(materialIDs);
+    return (materialIDs[pixelID]);
+}
+
+void Film::writeAovs(std::ostream &out) const
+{
+    const uint32_t pixelCount = croppedPixelBounds.surfaceArea();
+    out.write(reinterpret_cast<const char *>(&aovs), sizeof(aovs));
+    if (albedos)
+        out.write(reinterpret_cast<const char *>(albedos.get()), 3 * sizeof(uint16_t) * pixelCount);
+    if (normals)
+        out.write(reinterpret_cast<const char *>(normals.get()), sizeof(uint32_t) * pixelCount);
+    if (depths)
+        out.write(reinterpret_cast<const char *>(depths.get()), sizeof(uint16_t) * pixelCount);
+    if (materialIDs)
+        out.write(reinterpret_cast<const char *>(materialIDs.get()), sizeof(uint32_t) * pixelCount);
+}
+
+bool Film::readAovs(std::istream &in)
+{
+    uint32_t storedAovs = 0;
+    in.read(reinterpret_cast<char *>(&storedAovs), sizeof(storedAovs));
+    if (!in || storedAovs != aovs)
+        return (false);
+
+    const uint32_t pixelCount = croppedPixelBounds.surfaceArea();
+    if (albedos)
+        in.read(reinterpret_cast<char *>(albedos.get()), 3 * sizeof(uint16_t) * pixelCount);
+    if (normals)
+        in.read(reinterpret_cast<char *>(normals.get()), sizeof(uint32_t) * pixelCount);
+    if (depths)
+        in.read(reinterpret_cast<char *>(depths.get()), sizeof(uint16_t) * pixelCount);
+    if (materialIDs)
+        in.read(reinterpret_cast<char *>(materialIDs.get()), sizeof(uint32_t) * pixelCount);
+    return (bool(in));
+}
+
 void Film::writeImage(Float splatScale)
 {
     std::unique_ptr<Float[]> rgb(new Float[3 * croppedPixelBounds.surfaceArea()]);
@@ -158,6 +303,35 @@ void Film::writeImage(Float splatScale)
     writeImageToFile(filename, &rgb[0], croppedPixelBounds, resolution);
 }
 
+void Film::writeAov(AovFlags aov, const std::string &name) const
+{
+    CHECK(hasAov(aov));
+    const uint32_t pixelCount = croppedPixelBounds.surfaceArea();
+    std::unique_ptr<Float[]> rgb(new Float[3 * pixelCount]);
+    for (uint32_t i = 0; i < pixelCount; ++i)
+    {
+        Float *dst = &rgb[3 * i];
+        if (aov == AovFlags::Albedo)
+        {
+            const Spectrum albedo = getAlbedo(i);
+            dst[0] = albedo.r;
+            dst[1] = albedo.g;
+            dst[2] = albedo.b;
+        }
+        else if (aov == AovFlags::Normal)
+        {
+            const Normal n = getNormal(i);
+            dst[0] = n.x;
+            dst[1] = n.y;
+            dst[2] = n.z;
+        }
+        else
+            dst[0] = dst[1] = dst[2] = aov == AovFlags::Depth ? getDepth(i) : (Float)getMaterialID(i);
+    }
+
+    writeImageToFile(name, &rgb[0], croppedPixelBounds, resolution);
+}
+
 void Film::clear()
 {
     for (Point2i p : croppedPixelBounds)
@@ -166,4 +340,18 @@ void Film::clear()
         pixel.color = Spectrum(0);
         pixel.filterWeightSum = 0;
     }
+
+    // Pixels the camera rays never reach keep a black albedo, a normal along z, an infinite depth and the ID 0
+    const uint32_t pixelCount = croppedPixelBounds.surfaceArea();
+    for (uint32_t i = 0; i < pixelCount; ++i)
+    {
+        if (albedos)
+            albedos[3 * i] = albedos[3 * i + 1] = albedos[3 * i + 2] = 0;
+        if (normals)
+            normals[i] = 0x80008000;
+        if (depths)
+            depths[i] = 0x7C00;
+        if (materialIDs)
+            materialIDs[i] = 0;
+    }
 }
\ No newline at end of file
@@ -1,34 +1,156 @@
 #include "atlas/core/FilmIterator.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 using namespace atlas;
 
 FilmIterator::FilmIterator(Film::Pixel *pixels, uint32_t size)
 	: pixels(pixels)
 	, size(size)
+	, iterationPixels(new Film::Pixel[size])
+	, stats(new PixelStats[size])
 {}
 
 void FilmIterator::start(uint32_t newSampleCount)
 {
-	if (itCount != 0)
-		save();
+	if (itCount == 0)
+	{
+		for (uint32_t i = 0; i < size; i++)
+			pixels[i] = Film::Pixel();
+	}
+	merge();
 	sampleCount = newSampleCount;
 	clear(sampleCount);
 	itCount++;
+	pending = true;
 }
 
 void FilmIterator::clear(uint32_t sampleCount)
 {
 	for (uint32_t i = 0; i < size; i++)
 	{
-		pixels[i].color = BLACK;
-		pixels[i].filterWeightSum = sampleCount;
+		iterationPixels[i].color = BLACK;
+		iterationPixels[i].filterWeightSum = !active || active[i] ? (Float)sampleCount : 0;
 	}
 }
 
+void FilmIterator::merge()
+{
+	if (!pending)
+		return;
+
+	for (uint32_t i = 0; i < size; i++)
+	{
+		const Float w = iterationPixels[i].filterWeightSum;
+		if (w == 0)
+			continue;
+		pixels[i].color += iterationPixels[i].color;
+		pixels[i].filterWeightSum += w;
+
+		PixelStats &s = stats[i];
+		const Float x = luminance(iterationPixels[i].color) / w;
+		const Float delta = x - s.mean;
+		s.weight += w;
+		s.mean += delta * w / s.weight;
+		s.m2 += w * delta * (x - s.mean);
+		s.count++;
+	}
+	pending = false;
+
+	mergedCount++;
+	if (snapshotInterval && mergedCount % snapshotInterval == 0)
+		save();
+}
+
+Float FilmIterator::getPixelVariance(uint32_t pixelID) const
+{
+	const PixelStats &s = stats[pixelID];
+	if (s.count < 2)
+		return (INFINITY);
+	// Each iteration mean has a variance of sigma^2 / w, m2 / (count - 1) estimates sigma^2
+	return (std::max(s.m2 / ((Float)(s.count - 1) * s.weight), (Float)0));
+}
+
+Float FilmIterator::getPixelError(uint32_t pixelID) const
+{
+	return (std::sqrt(getPixelVariance(pixelID)) / (std::abs(stats[pixelID].mean) + (Float)1e-3));
+}
+
+uint32_t FilmIterator::updateActivePixels(Float errorThreshold, uint32_t minIterations)
+{
+	if (!active)
+		active.reset(new uint8_t[size]);
+
+	uint32_t unconvergedCount = 0;
+	for (uint32_t i = 0; i < size; i++)
+	{
+		active[i] = stats[i].count < minIterations || getPixelError(i) > errorThreshold;
+		unconvergedCount += active[i];
+	}
+	if (unconvergedCount == 0)
+		return (0);
+
+	// A few iteration means can all miss the rare paths of a pixel and show no variance. Converged
+	// pixels are given an iteration again every RecheckInterval merges, staggered over the film,
+	// so that a path found late brings them back.
+	for (uint32_t i = 0; i < size; i++)
+		active[i] |= (mergedCount + i) % RecheckInterval == 0;
+	return (unconvergedCount);
+}
+
+void FilmIterator::write(std::ostream &out) const
+{
+	DCHECK(!pending);
+	const uint8_t hasActive = active != nullptr;
+	out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+	out.write(reinterpret_cast<const char *>(&itCount), sizeof(itCount));
+	out.write(reinterpret_cast<const char *>(&mergedCount), sizeof(mergedCount));
+	out.write(reinterpret_cast<const char *>(pixels), sizeof(Film::Pixel) * size);
+	out.write(reinterpret_cast<const char *>(stats.get()), sizeof(PixelStats) * size);
+	out.write(reinterpret_cast<const char *>(&hasActive), sizeof(hasActive));
+	if (hasActive)
+		out.write(reinterpret_cast<const char *>(active.get()), size);
+}
+
+bool FilmIterator::read(std::istream &in)
+{
+	uint32_t storedSize = 0;
+	in.read(reinterpret_cast<char *>(&storedSize), sizeof(storedSize));
+	if (!in || storedSize != size)
+		return (false);
+
+	uint8_t hasActive = 0;
+	in.read(reinterpret_cast<char *>(&itCount), sizeof(itCount));
+	in.read(reinterpret_cast<char *>(&mergedCount), sizeof(mergedCount));
+	in.read(reinterpret_cast<char *>(pixels), sizeof(Film::Pixel) * size);
+	in.read(reinterpret_cast<char *>(stats.get()), sizeof(PixelStats) * size);
+	in.read(reinterpret_cast<char *>(&hasActive), sizeof(hasActive));
+	if (hasActive)
+	{
+		active.reset(new uint8_t[size]);
+		in.read(reinterpret_cast<char *>(active.get()), size);
+	}
+	else
+		active.reset();
+	pending = false;
+	if (in)
+		return (true);
+
+	// Truncated stream, the next iteration starts over from an empty film
+	itCount = 0;
+	mergedCount = 0;
+	active.reset();
+	for (uint32_t i = 0; i < size; i++)
+		stats[i] = PixelStats();
+	return (false);
+}
+
 void FilmIterator::save()
 {
 	uint32_t flags = CREATE_ALWAYS;
-	std::string filename = "iteration-" + std::to_string(itCount) + ".tmp";
+	const std::string filename = "snapshot.tmp";
 	const size_t byteSize = sizeof(Film::Pixel) * size;
 	void *file = CreateFileA(filename.c_str(), GENERIC_WRITE | GENERIC_READ, 0, nullptr, flags, FILE_ATTRIBUTE_TEMPORARY, nullptr);
 	CHECK_WIN_CALL(file != INVALID_HANDLE_VALUE);
@@ -37,10 +159,7 @@ void FilmIterator::save()
 	Film::Pixel *buffer = (Film::Pixel *)MapViewOfFile(mapping, FILE_MAP_WRITE | FILE_MAP_READ, 0, 0, byteSize);
 	CHECK_WIN_CALL(buffer != nullptr);
 
-	for (uint32_t i = 0; i < size; i++)
-	{
-		buffer[i] = pixels[i];
-	}
+	std::memcpy(buffer, pixels, byteSize);
 
 	FlushViewOfFile(buffer, byteSize);
 	UnmapViewOfFile(buffer);
@@ -50,26 +169,5 @@ void FilmIterator::save()
 
 void FilmIterator::accumulate()
 {
-	for (uint32_t i = 1; i < itCount; i++)
-	{
-		uint32_t flags = OPEN_EXISTING;
-		std::string filename = "iteration-" + std::to_string(i) + ".tmp";
-		const size_t byteSize = sizeof(Film::Pixel) * size;
-		void *file = CreateFileA(filename.c_str(), GENERIC_WRITE | GENERIC_READ, 0, nullptr, flags, FILE_ATTRIBUTE_TEMPORARY, nullptr);
-		CHECK_WIN_CALL(file != INVALID_HANDLE_VALUE);
-		void *mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, byteSize, nullptr);
-		CHECK_WIN_CALL(mapping != INVALID_HANDLE_VALUE);
-		Film::Pixel *buffer = (Film::Pixel *)MapViewOfFile(mapping, FILE_MAP_WRITE | FILE_MAP_READ, 0, 0, byteSize);
-		CHECK_WIN_CALL(buffer != nullptr);
-
-		for (uint32_t i = 0; i < size; i++)
-		{
-			pixels[i].color += buffer[i].color;
-			pixels[i].filterWeightSum += buffer[i].filterWeightSum;
-		}
-
-		UnmapViewOfFile(buffer);
-		CloseHandle(mapping);
-		CloseHandle(file);
-	}
-}
\ No newline at end of file
+	merge();
+}
@@ -13,6 +13,12 @@ bool GeometricPrimitive::intersect(const Ray &r, SurfaceInteraction &intersectio
 	if (!shape->intersect(r, tHit, intersection))
 		return (false);
 	r.tmax = tHit;
+	completeInteraction(r, intersection);
+	return (true);
+}
+
+void GeometricPrimitive::completeInteraction(const Ray &r, SurfaceInteraction &intersection) const
+{
 	intersection.primitive = this;
 	intersection.material = material.get();
 
@@ -20,7 +26,6 @@ bool GeometricPrimitive::intersect(const Ray &r, SurfaceInteraction &intersectio
 		intersection.mediumInterface = mediumInterface;
 	else
 		intersection.mediumInterface = MediumInterface(r.medium);
-	return (true);
 }
 
 bool GeometricPrimitive::intersectP(const Ray &r) const
@@ -0,0 +1,206 @@
+#include "atlas/core/ImageIO.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "atlas/core/Half.h"
+#include "atlas/core/Logging.h"
+
+using namespace atlas;
+
+namespace
+{
+	// Converts the rows on every core, each row is written at its own place in the file buffer
+	template <typename Function>
+	void parallelRows(int32_t height, const Function &function)
+	{
+		const int32_t threadCount = std::max(1, std::min<int32_t>(std::thread::hardware_concurrency(), height / 16));
+		std::vector<std::thread> threads;
+		for (int32_t t = 1; t < threadCount; t++)
+		{
+			threads.emplace_back([&function, t, threadCount, height]()
+				{
+					for (int32_t y = t; y < height; y += threadCount)
+						function(y);
+				});
+		}
+		for (int32_t y = 0; y < height; y += threadCount)
+			function(y);
+		for (std::thread &thread : threads)
+			thread.join();
+	}
+
+	void append(std::vector<uint8_t> &buffer, const void *data, size_t size)
+	{
+		const uint8_t *bytes = static_cast<const uint8_t *>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	template <typename T>
+	void append(std::vector<uint8_t> &buffer, const T &value)
+	{
+		append(buffer, &value, sizeof(T));
+	}
+
+	void appendAttribute(std::vector<uint8_t> &buffer, const char *name, const char *type, const void *data, int32_t size)
+	{
+		append(buffer, name, std::strlen(name) + 1);
+		append(buffer, type, std::strlen(type) + 1);
+		append(buffer, size);
+		append(buffer, data, size);
+	}
+
+	void encodePpm(std::vector<uint8_t> &buffer, const Float *rgb, int32_t width, int32_t height)
+	{
+		const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+		append(buffer, header.data(), header.size());
+		const size_t start = buffer.size();
+		buffer.resize(start + (size_t)width * height * 3);
+
+		parallelRows(height, [&](int32_t y)
+			{
+				uint8_t *dst = &buffer[start + (size_t)y * width * 3];
+				const Float *src = rgb + (size_t)y * width * 3;
+				for (int32_t i = 0; i < width * 3; i++)
+					dst[i] = (uint8_t)std::min(255.f, std::max(0.f, (float)(255.99 * src[i])));
+			});
+	}
+
+	void encodePfm(std::vector<uint8_t> &buffer, const Float *rgb, int32_t width, int32_t height)
+	{
+		// A negative scale means little endian
+		const std::string header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+		append(buffer, header.data(), header.size());
+		const size_t start = buffer.size();
+		buffer.resize(start + (size_t)width * height * 3 * sizeof(float));
+
+		// Rows are stored bottom to top
+		parallelRows(height, [&](int32_t y)
+			{
+				float *dst = reinterpret_cast<float *>(&buffer[start + (size_t)(height - 1 - y) * width * 3 * sizeof(float)]);
+				const Float *src = rgb + (size_t)y * width * 3;
+				for (int32_t i = 0; i < width * 3; i++)
+					dst[i] = (float)src[i];
+			});
+	}
+
+	void encodeExr(std::vector<uint8_t> &buffer, const Float *rgb, const Bounds2i &bounds, const Point2i &resolution)
+	{
+		const int32_t width = bounds.max.x - bounds.min.x;
+		const int32_t height = bounds.max.y - bounds.min.y;
+
+		const uint32_t magic = 20000630;
+		const uint32_t version = 2;
+		append(buffer, magic);
+		append(buffer, version);
+
+		// Channels are sorted by name, B G R
+		std::vector<uint8_t> channels;
+		for (const char *name : { "B", "G", "R" })
+		{
+			const int32_t halfType = 1;
+			const uint8_t linearAndReserved[4] = {};
+			const int32_t sampling[2] = { 1, 1 };
+			append(channels, name, 2);
+			append(channels, halfType);
+			append(channels, linearAndReserved, sizeof(linearAndReserved));
+			append(channels, sampling, sizeof(sampling));
+		}
+		channels.push_back(0);
+		appendAttribute(buffer, "channels", "chlist", channels.data(), (int32_t)channels.size());
+
+		const uint8_t noCompression = 0;
+		appendAttribute(buffer, "compression", "compression", &noCompression, 1);
+		const int32_t dataWindow[4] = { bounds.min.x, bounds.min.y, bounds.max.x - 1, bounds.max.y - 1 };
+		appendAttribute(buffer, "dataWindow", "box2i", dataWindow, sizeof(dataWindow));
+		const int32_t displayWindow[4] = { 0, 0, resolution.x - 1, resolution.y - 1 };
+		appendAttribute(buffer, "displayWindow", "box2i", displayWindow, sizeof(displayWindow));
+		const uint8_t increasingY = 0;
+		appendAttribute(buffer, "lineOrder", "lineOrder", &increasingY, 1);
+		const float one = 1.f;
+		appendAttribute(buffer, "pixelAspectRatio", "float", &one, sizeof(one));
+		const float center[2] = { 0.f, 0.f };
+		appendAttribute(buffer, "screenWindowCenter", "v2f", center, sizeof(center));
+		appendAttribute(buffer, "screenWindowWidth", "float", &one, sizeof(one));
+		buffer.push_back(0);
+
+		// One scanline per block, without compression every block has the same size
+		const int32_t blockDataSize = width * 3 * (int32_t)sizeof(uint16_t);
+		const size_t blockSize = 2 * sizeof(int32_t) + blockDataSize;
+		const size_t offsetTable = buffer.size();
+		const size_t firstBlock = offsetTable + (size_t)height * sizeof(uint64_t);
+		buffer.resize(firstBlock + (size_t)height * blockSize);
+
+		parallelRows(height, [&](int32_t y)
+			{
+				const uint64_t offset = firstBlock + (size_t)y * blockSize;
+				std::memcpy(&buffer[offsetTable + (size_t)y * sizeof(uint64_t)], &offset, sizeof(offset));
+
+				uint8_t *block = &buffer[offset];
+				const int32_t lineY = bounds.min.y + y;
+				std::memcpy(block, &lineY, sizeof(lineY));
+				std::memcpy(block + sizeof(int32_t), &blockDataSize, sizeof(blockDataSize));
+
+				uint16_t *halfs = reinterpret_cast<uint16_t *>(block + 2 * sizeof(int32_t));
+				const Float *src = rgb + (size_t)y * width * 3;
+				for (int32_t c = 0; c < 3; c++)
+				{
+					uint16_t *dst = halfs + c * width;
+					const int32_t channel = 2 - c;
+					for (int32_t x = 0; x < width; x++)
+						dst[x] = toHalf((float)src[x * 3 + channel]);
+				}
+			});
+	}
+}
+
+ImageFormat atlas::getImageFormat(const std::string &name)
+{
+	const size_t dot = name.find_last_of('.');
+	if (dot == std::string::npos)
+		return (ImageFormat::Ppm);
+
+	std::string extension = name.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return ((char)std::tolower(c)); });
+	if (extension == "pfm")
+		return (ImageFormat::Pfm);
+	if (extension == "exr")
+		return (ImageFormat::Exr);
+	return (ImageFormat::Ppm);
+}
+
+void atlas::writeImageToFile(const std::string &name, const Float *rgb,
+	const Bounds2i &outputBounds, const Point2i &totalResolution)
+{
+	writeImageToFile(name, getImageFormat(name), rgb, outputBounds, totalResolution);
+}
+
+void atlas::writeImageToFile(const std::string &name, ImageFormat format, const Float *rgb,
+	const Bounds2i &outputBounds, const Point2i &totalResolution)
+{
+	const int32_t width = outputBounds.max.x - outputBounds.min.x;
+	const int32_t height = outputBounds.max.y - outputBounds.min.y;
+	CHECK(width > 0 && height > 0);
+
+	std::vector<uint8_t> buffer;
+	switch (format)
+	{
+	case ImageFormat::Pfm:
+		encodePfm(buffer, rgb, width, height);
+		break;
+	case ImageFormat::Exr:
+		encodeExr(buffer, rgb, outputBounds, totalResolution);
+		break;
+	default:
+		encodePpm(buffer, rgb, width, height);
+		break;
+	}
+
+	std::ofstream file(name, std::ios::binary | std::ios::trunc);
+	CHECK(file);
+	file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+}
@@ -1,5 +1,6 @@
 #include "atlas/core/Interaction.h"
 
+#include "atlas/core/Geometry.h"
 #include "atlas/core/Primitive.h"
 #include "atlas/core/Shape.h"
 
@@ -111,6 +112,23 @@ void SurfaceInteraction::computeDifferentials(const RayDifferential &ray) const
     }
 }
 
+void SurfaceInteraction::computeDifferentials(const Ray &r, Float coneWidth, Float coneSpread) const
+{
+    RayDifferential ray(r);
+    if (coneWidth > 0 || coneSpread > 0)
+    {
+        Vec3f dx;
+        Vec3f dy;
+        coordinateSystem(ray.dir, &dx, &dy);
+        ray.rxOrigin = ray.origin + coneWidth * dx;
+        ray.ryOrigin = ray.origin + coneWidth * dy;
+        ray.rxDirection = ray.dir + coneSpread * dx;
+        ray.ryDirection = ray.dir + coneSpread * dy;
+        ray.hasDifferentials = true;
+    }
+    computeDifferentials(ray);
+}
+
 Spectrum SurfaceInteraction::le(const Vec3f &w) const
 {
     const AreaLight *area = primitive->getAreaLight();
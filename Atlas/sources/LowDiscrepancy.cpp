@@ -0,0 +1,350 @@
+#include "atlas/core/LowDiscrepancy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tmmintrin.h>
+#include <smmintrin.h>
+
+#include "atlas/core/Logging.h"
+
+namespace
+{
+	const uint32_t Primes[atlas::PrimeTableSize] = {
+		2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+		59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+		137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+		227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311
+	};
+
+	struct DirectionNumbers
+	{
+		uint32_t degree;
+		uint32_t coefficients;
+		uint32_t m[6];
+	};
+
+	// new-joe-kuo-6.21201, dimensions 2 to 16. The first dimension is the van der Corput sequence.
+	const DirectionNumbers JoeKuo[atlas::SobolDimensions - 1] = {
+		{ 1, 0, { 1 } },
+		{ 2, 1, { 1, 3 } },
+		{ 3, 1, { 1, 3, 1 } },
+		{ 3, 2, { 1, 1, 1 } },
+		{ 4, 1, { 1, 1, 3, 3 } },
+		{ 4, 4, { 1, 3, 5, 13 } },
+		{ 5, 2, { 1, 1, 5, 5, 17 } },
+		{ 5, 4, { 1, 1, 5, 5, 5 } },
+		{ 5, 7, { 1, 1, 7, 11, 19 } },
+		{ 5, 11, { 1, 1, 5, 1, 1 } },
+		{ 5, 13, { 1, 1, 1, 3, 11 } },
+		{ 5, 14, { 1, 3, 5, 5, 31 } },
+		{ 6, 1, { 1, 3, 3, 9, 7, 49 } },
+		{ 6, 13, { 1, 1, 1, 15, 21, 21 } },
+		{ 6, 16, { 1, 3, 1, 13, 27, 49 } }
+	};
+
+	static constexpr uint32_t RowSize = atlas::SobolDimensions + 4;
+
+	struct SobolMatrices
+	{
+		alignas(16) uint32_t data[atlas::SobolMatrixSize * RowSize] = {};
+
+		SobolMatrices()
+		{
+			for (uint32_t i = 0; i < atlas::SobolMatrixSize; i++)
+				data[i * RowSize] = 1u << (31 - i);
+
+			for (uint32_t d = 1; d < atlas::SobolDimensions; d++)
+			{
+				const DirectionNumbers &dn = JoeKuo[d - 1];
+				const uint32_t s = dn.degree;
+				uint32_t v[atlas::SobolMatrixSize];
+				for (uint32_t i = 0; i < s; i++)
+					v[i] = dn.m[i] << (31 - i);
+				for (uint32_t i = s; i < atlas::SobolMatrixSize; i++)
+				{
+					v[i] = v[i - s] ^ (v[i - s] >> s);
+					for (uint32_t k = 1; k < s; k++)
+						v[i] ^= ((dn.coefficients >> (s - 1 - k)) & 1) * v[i - k];
+				}
+				for (uint32_t i = 0; i < atlas::SobolMatrixSize; i++)
+					data[i * RowSize + d] = v[i];
+			}
+		}
+	};
+
+	const SobolMatrices Matrices;
+
+	inline __m128i reverseBits4(__m128i v)
+	{
+		const __m128i byteSwap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+		const __m128i nibbleReverse = _mm_setr_epi8(0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+		const __m128i lowNibbles = _mm_set1_epi8(0x0f);
+
+		v = _mm_shuffle_epi8(v, byteSwap);
+		__m128i lo = _mm_and_si128(v, lowNibbles);
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), lowNibbles);
+		return (_mm_or_si128(_mm_slli_epi16(_mm_shuffle_epi8(nibbleReverse, lo), 4), _mm_shuffle_epi8(nibbleReverse, hi)));
+	}
+
+	inline __m128i laineKarrasPermutation4(__m128i x, __m128i seed)
+	{
+		x = _mm_add_epi32(x, seed);
+		x = _mm_xor_si128(x, _mm_mullo_epi32(x, _mm_set1_epi32(0x6c50b47c)));
+		x = _mm_xor_si128(x, _mm_mullo_epi32(x, _mm_set1_epi32((int)0xb82f1e52)));
+		x = _mm_xor_si128(x, _mm_mullo_epi32(x, _mm_set1_epi32((int)0xc7afe638)));
+		x = _mm_xor_si128(x, _mm_mullo_epi32(x, _mm_set1_epi32((int)0x8d22f6e6)));
+		return (x);
+	}
+
+	struct BlueNoiseTile
+	{
+		uint16_t ranks[atlas::BlueNoiseTileSize * atlas::BlueNoiseTileSize];
+
+		// Ulichney's void-and-cluster method with a gaussian energy on the torus
+		BlueNoiseTile()
+		{
+			const uint32_t size = atlas::BlueNoiseTileSize;
+			const uint32_t count = size * size;
+
+			std::vector<float> kernel(count);
+			for (uint32_t y = 0; y < size; y++)
+			{
+				for (uint32_t x = 0; x < size; x++)
+				{
+					const float dx = (float)std::min(x, size - x);
+					const float dy = (float)std::min(y, size - y);
+					kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.f * 1.5f * 1.5f));
+				}
+			}
+
+			std::vector<float> energy(count, 0.f);
+			std::vector<uint8_t> pattern(count, 0);
+			auto splat = [&](uint32_t p, float sign)
+			{
+				const uint32_t px = p % size;
+				const uint32_t py = p / size;
+				for (uint32_t y = 0; y < size; y++)
+				{
+					const float *row = kernel.data() + ((y - py) & (size - 1)) * size;
+					for (uint32_t x = 0; x < size; x++)
+						energy[y * size + x] += sign * row[(x - px) & (size - 1)];
+				}
+			};
+			auto set = [&](uint32_t p, uint8_t value)
+			{
+				pattern[p] = value;
+				splat(p, value ? 1.f : -1.f);
+			};
+			auto tightestCluster = [&]()
+			{
+				uint32_t best = 0;
+				float bestEnergy = -1.f;
+				for (uint32_t i = 0; i < count; i++)
+				{
+					if (pattern[i] && energy[i] > bestEnergy)
+					{
+						best = i;
+						bestEnergy = energy[i];
+					}
+				}
+				return (best);
+			};
+			// Among the empty texels, the one with the lowest energy of the points is also the
+			// tightest cluster of empty texels, the same search covers the last phase
+			auto largestVoid = [&]()
+			{
+				uint32_t best = 0;
+				float bestEnergy = std::numeric_limits<float>::infinity();
+				for (uint32_t i = 0; i < count; i++)
+				{
+					if (!pattern[i] && energy[i] < bestEnergy)
+					{
+						best = i;
+						bestEnergy = energy[i];
+					}
+				}
+				return (best);
+			};
+
+			atlas::RNG rng(0xb1e);
+			const uint32_t initialCount = count / 10;
+			for (uint32_t placed = 0; placed < initialCount;)
+			{
+				uint32_t p = rng.uniformUInt32(count);
+				if (!pattern[p])
+				{
+					set(p, 1);
+					placed++;
+				}
+			}
+
+			for (uint32_t i = 0; i < count; i++)
+			{
+				uint32_t cluster = tightestCluster();
+				set(cluster, 0);
+				uint32_t hole = largestVoid();
+				set(hole, 1);
+				if (hole == cluster)
+					break;
+			}
+
+			const std::vector<uint8_t> prototype = pattern;
+			const std::vector<float> prototypeEnergy = energy;
+			for (uint32_t rank = initialCount; rank-- > 0;)
+			{
+				uint32_t cluster = tightestCluster();
+				set(cluster, 0);
+				ranks[cluster] = (uint16_t)rank;
+			}
+
+			pattern = prototype;
+			energy = prototypeEnergy;
+			for (uint32_t rank = initialCount; rank < count; rank++)
+			{
+				uint32_t hole = largestVoid();
+				set(hole, 1);
+				ranks[hole] = (uint16_t)rank;
+			}
+		}
+	};
+
+	void extendedGCD(uint64_t a, uint64_t b, int64_t &x, int64_t &y)
+	{
+		if (b == 0)
+		{
+			x = 1;
+			y = 0;
+			return;
+		}
+		int64_t d = a / b, xp, yp;
+		extendedGCD(b, a % b, xp, yp);
+		x = yp;
+		y = xp - (d * yp);
+	}
+}
+
+const uint32_t *atlas::getSobolMatrices()
+{
+	return (Matrices.data);
+}
+
+uint32_t atlas::getPrime(uint32_t index)
+{
+	DCHECK(index < PrimeTableSize);
+	return (Primes[index]);
+}
+
+uint32_t atlas::getPrimeSum(uint32_t index)
+{
+	DCHECK(index < PrimeTableSize);
+	uint32_t sum = 0;
+	for (uint32_t i = 0; i < index; i++)
+		sum += Primes[i];
+	return (sum);
+}
+
+void atlas::sobolOwen4(uint32_t index, uint32_t dimension, const uint32_t seeds[4], Float values[4])
+{
+	if (dimension >= SobolDimensions)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+			values[i] = toUnitFloat(mixBits32(index ^ mixBits32(seeds[i] + dimension + i)));
+		return;
+	}
+
+	__m128i x = _mm_setzero_si128();
+	const uint32_t *column = Matrices.data + dimension;
+	for (uint32_t i = index; i; i >>= 1, column += RowSize)
+	{
+		if (i & 1)
+			x = _mm_xor_si128(x, _mm_loadu_si128(reinterpret_cast<const __m128i *>(column)));
+	}
+
+	x = reverseBits4(laineKarrasPermutation4(reverseBits4(x), _mm_loadu_si128(reinterpret_cast<const __m128i *>(seeds))));
+
+	alignas(16) float result[4];
+	_mm_store_ps(result, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), _mm_set1_ps(5.9604644775390625e-08f)));
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		if (dimension + i < SobolDimensions)
+			values[i] = result[i];
+		else
+			values[i] = toUnitFloat(mixBits32(index ^ mixBits32(seeds[i] + dimension + i)));
+	}
+}
+
+const uint16_t *atlas::getBlueNoiseTile()
+{
+	static const BlueNoiseTile tile;
+	return (tile.ranks);
+}
+
+Float atlas::radicalInverse(uint32_t baseIndex, uint64_t a)
+{
+	const uint32_t base = getPrime(baseIndex);
+	const Float invBase = (Float)1 / (Float)base;
+	uint64_t reversedDigits = 0;
+	Float invBaseN = 1;
+	while (a)
+	{
+		uint64_t next = a / base;
+		uint64_t digit = a - next * base;
+		reversedDigits = reversedDigits * base + digit;
+		invBaseN *= invBase;
+		a = next;
+	}
+	return (std::min(reversedDigits * invBaseN, OneMinusEpsilon));
+}
+
+Float atlas::scrambledRadicalInverse(uint32_t baseIndex, uint64_t a, const uint16_t *perm)
+{
+	const uint32_t base = getPrime(baseIndex);
+	const Float invBase = (Float)1 / (Float)base;
+	uint64_t reversedDigits = 0;
+	Float invBaseN = 1;
+	while (a)
+	{
+		uint64_t next = a / base;
+		uint64_t digit = a - next * base;
+		reversedDigits = reversedDigits * base + perm[digit];
+		invBaseN *= invBase;
+		a = next;
+	}
+	// The infinite tail of zero digits is permuted too
+	return (std::min(invBaseN * (reversedDigits + invBase * perm[0] / (1 - invBase)), OneMinusEpsilon));
+}
+
+uint64_t atlas::inverseRadicalInverse(uint32_t base, uint64_t inverse, int nDigits)
+{
+	uint64_t index = 0;
+	for (int i = 0; i < nDigits; i++)
+	{
+		uint64_t digit = inverse % base;
+		inverse /= base;
+		index = index * base + digit;
+	}
+	return (index);
+}
+
+std::vector<uint16_t> atlas::computeRadicalInversePermutations(RNG &rng)
+{
+	std::vector<uint16_t> perms(getPrimeSum(PrimeTableSize - 1) + Primes[PrimeTableSize - 1]);
+	uint16_t *p = perms.data();
+	for (uint32_t i = 0; i < PrimeTableSize; i++)
+	{
+		for (uint32_t j = 0; j < Primes[i]; j++)
+			p[j] = (uint16_t)j;
+		for (uint32_t j = 0; j < Primes[i]; j++)
+			std::swap(p[j], p[j + rng.uniformUInt32(Primes[i] - j)]);
+		p += Primes[i];
+	}
+	return (perms);
+}
+
+uint64_t atlas::multiplicativeInverse(int64_t a, int64_t n)
+{
+	int64_t x, y;
+	extendedGCD(a, n, x, y);
+	return (((x % n) + n) % n);
+}
@@ -1,5 +1,7 @@
 #include "atlas/core/Random.h"
 
+#include <immintrin.h>
+
 using namespace atlas;
 
 Float atlas::random()
@@ -13,4 +15,134 @@ Float atlas::random()
 	x = y; y = z; z = w;
 	w = w ^ (w >> 19) ^ (t ^ (t >> 8));
 	return (static_cast<float>(w & 0xffffff) / 16777216.0f);
-}
\ No newline at end of file
+}
+
+namespace
+{
+#ifdef __AVX2__
+	typedef __m256i StreamVector;
+	static constexpr uint32_t StreamLanes = 4;
+
+	// Low 64 bits of the product, there is no 64 bit multiply before AVX-512
+	inline __m256i mul64(__m256i a, __m256i b)
+	{
+		__m256i lo = _mm256_mul_epu32(a, b);
+		__m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+		return (_mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32)));
+	}
+#else
+	typedef __m128i StreamVector;
+	static constexpr uint32_t StreamLanes = 2;
+
+	inline __m128i mul64(__m128i a, __m128i b)
+	{
+		__m128i lo = _mm_mul_epu32(a, b);
+		__m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b), _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+		return (_mm_add_epi64(lo, _mm_slli_epi64(cross, 32)));
+	}
+
+	// Rotates each lane left by k, SSE has no variable shift so the shifts are done with multiplies by 2^k
+	inline __m128i rotateLeft(__m128i x, __m128i k)
+	{
+		__m128i pow2 = _mm_cvttps_epi32(_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(k, _mm_set1_epi32(127)), 23)));
+		__m128i low = _mm_mullo_epi32(x, pow2);
+		__m128i even = _mm_srli_epi64(_mm_mul_epu32(x, pow2), 32);
+		__m128i odd = _mm_and_si128(_mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(pow2, 32)), _mm_set_epi32(-1, 0, -1, 0));
+		return (_mm_or_si128(low, _mm_or_si128(even, odd)));
+	}
+#endif
+}
+
+void RNGStreams::setSequence(uint64_t firstSequence)
+{
+	for (uint32_t i = 0; i < StreamCount; i++)
+	{
+		RNG rng(firstSequence + i);
+		state[i] = rng.state;
+		inc[i] = rng.inc;
+	}
+}
+
+void RNGStreams::next(uint32_t values[StreamCount])
+{
+#ifdef __AVX2__
+	const __m256i mult = _mm256_set1_epi64x(PCG32_MULT);
+	const __m256i gather = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	for (uint32_t i = 0; i < StreamCount; i += StreamLanes)
+	{
+		__m256i old = _mm256_load_si256(reinterpret_cast<const __m256i *>(state + i));
+		__m256i increment = _mm256_load_si256(reinterpret_cast<const __m256i *>(inc + i));
+		_mm256_store_si256(reinterpret_cast<__m256i *>(state + i), _mm256_add_epi64(mul64(old, mult), increment));
+
+		// Only the low half of each 64 bit lane is used, the high half is shifted by zero
+		__m256i xorshifted = _mm256_srli_epi64(_mm256_xor_si256(_mm256_srli_epi64(old, 18), old), 27);
+		__m256i rot = _mm256_srli_epi64(old, 59);
+		__m256i rotated = _mm256_or_si256(_mm256_srlv_epi32(xorshifted, rot),
+			_mm256_sllv_epi32(xorshifted, _mm256_and_si256(_mm256_sub_epi32(_mm256_setzero_si256(), rot), _mm256_set1_epi64x(31))));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(rotated, gather)));
+	}
+#else
+	const __m128i mult = _mm_set1_epi64x(PCG32_MULT);
+	for (uint32_t i = 0; i < StreamCount; i += 2 * StreamLanes)
+	{
+		__m128i xorshifted[2];
+		__m128i rot[2];
+		for (uint32_t j = 0; j < 2; j++)
+		{
+			uint64_t *s = state + i + j * StreamLanes;
+			__m128i old = _mm_load_si128(reinterpret_cast<const __m128i *>(s));
+			__m128i increment = _mm_load_si128(reinterpret_cast<const __m128i *>(inc + i + j * StreamLanes));
+			_mm_store_si128(reinterpret_cast<__m128i *>(s), _mm_add_epi64(mul64(old, mult), increment));
+			xorshifted[j] = _mm_srli_epi64(_mm_xor_si128(_mm_srli_epi64(old, 18), old), 27);
+			rot[j] = _mm_srli_epi64(old, 59);
+		}
+
+		__m128i x = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(xorshifted[0]), _mm_castsi128_ps(xorshifted[1]), _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i r = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(rot[0]), _mm_castsi128_ps(rot[1]), _MM_SHUFFLE(2, 0, 2, 0)));
+		// Rotating right by r is rotating left by (32 - r) & 31
+		__m128i k = _mm_and_si128(_mm_sub_epi32(_mm_set1_epi32(32), r), _mm_set1_epi32(31));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), rotateLeft(x, k));
+	}
+#endif
+}
+
+void RNGStreams::uniformUInt32(uint32_t *values, uint32_t count)
+{
+	uint32_t i = 0;
+	for (; i + StreamCount <= count; i += StreamCount)
+		next(values + i);
+	if (i < count)
+	{
+		uint32_t tail[StreamCount];
+		next(tail);
+		for (uint32_t j = 0; i < count; i++, j++)
+			values[i] = tail[j];
+	}
+}
+
+void RNGStreams::uniformFloat(Float *values, uint32_t count)
+{
+	uint32_t bits[StreamCount];
+	for (uint32_t i = 0; i < count; i += StreamCount)
+	{
+		next(bits);
+		const uint32_t n = std::min(StreamCount, count - i);
+		for (uint32_t j = 0; j < n; j++)
+			values[i + j] = (Float)(bits[j] >> 8) * (Float)5.9604644775390625e-08;
+	}
+}
+
+void RNGStreams::uniform2D(Point2f *points, uint32_t count)
+{
+	uint32_t bits[StreamCount];
+	for (uint32_t i = 0; i < count; i += StreamCount / 2)
+	{
+		next(bits);
+		const uint32_t n = std::min(StreamCount / 2, count - i);
+		for (uint32_t j = 0; j < n; j++)
+		{
+			points[i + j].x = (Float)(bits[2 * j] >> 8) * (Float)5.9604644775390625e-08;
+			points[i + j].y = (Float)(bits[2 * j + 1] >> 8) * (Float)5.9604644775390625e-08;
+		}
+	}
+}
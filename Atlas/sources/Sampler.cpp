@@ -1,6 +1,7 @@
 #include "atlas/core/Sampler.h"
 
 #include "atlas/core/Camera.h"
+#include "atlas/core/LowDiscrepancy.h"
 #include "atlas/core/Random.h"
 #include "atlas/core/Sampling.h"
 
@@ -128,8 +129,7 @@ void GlobalSampler::startPixel(const Point2i &p, bool initArray)
             for (int j = 0; j < nSamples; ++j)
             {
                 int64_t idx = getIndexForSample(j);
-                sampleArray2D[i][j].x = sampleDimension(idx, dim);
-                sampleArray2D[i][j].y = sampleDimension(idx, dim + 1);
+                sampleArray2D[i][j] = sampleDimension2D(idx, dim);
             }
             dim += 2;
         }
@@ -161,8 +161,7 @@ Point2f GlobalSampler::get2D()
 {
     if (dimension + 1 >= arrayStartDim && dimension < arrayEndDim)
         dimension = arrayEndDim;
-    Point2f p(sampleDimension(intervalSampleIndex, dimension),
-        sampleDimension(intervalSampleIndex, dimension + 1));
+    Point2f p = sampleDimension2D(intervalSampleIndex, dimension);
     dimension += 2;
     return p;
 }
@@ -171,12 +170,12 @@ void StratifiedSampler::startPixel(const Point2i &p, bool initArray)
 {
     for (size_t i = 0; i < samples1D.size(); ++i)
     {
-        stratifiedSample1D(&samples1D[i][0], xPixelSamples * yPixelSamples, rng, jitterSamples);
+        stratifiedSample1D(&samples1D[i][0], xPixelSamples * yPixelSamples, streams, jitterSamples);
         shuffle(&samples1D[i][0], xPixelSamples * yPixelSamples, 1, rng);
     }
     for (size_t i = 0; i < samples2D.size(); ++i)
     {
-        stratifiedSample2D(&samples2D[i][0], xPixelSamples, yPixelSamples, rng,
+        stratifiedSample2D(&samples2D[i][0], xPixelSamples, yPixelSamples, streams,
             jitterSamples);
         shuffle(&samples2D[i][0], xPixelSamples * yPixelSamples, 1, rng);
     }
@@ -187,7 +186,7 @@ void StratifiedSampler::startPixel(const Point2i &p, bool initArray)
             for (int64_t j = 0; j < samplesPerPixel; ++j)
             {
                 int count = samples1DArraySizes[i];
-                stratifiedSample1D(&sampleArray1D[i][j * count], count, rng,
+                stratifiedSample1D(&sampleArray1D[i][j * count], count, streams,
                     jitterSamples);
                 shuffle(&sampleArray1D[i][j * count], count, 1, rng);
             }
@@ -205,5 +204,129 @@ std::unique_ptr<Sampler> StratifiedSampler::clone(int seed)
 {
     StratifiedSampler *ss = new StratifiedSampler(*this);
     ss->rng.setSequence(seed);
+    ss->streams.setSequence((uint64_t)seed * RNGStreams::StreamCount);
     return std::unique_ptr<Sampler>(ss);
-}
\ No newline at end of file
+}
+
+uint32_t SobolSampler::getPixelSeed() const
+{
+    return mixBits32((uint32_t)currentPixel.x ^ mixBits32((uint32_t)currentPixel.y ^ mixBits32(seed + 0x9e3779b9)));
+}
+
+int64_t SobolSampler::getIndexForSample(int64_t sampleNum) const
+{
+    return nestedUniformScramble((uint32_t)sampleNum, getPixelSeed());
+}
+
+Float SobolSampler::sampleDimension(int64_t index, int dimension) const
+{
+    uint32_t dimensionSeed = mixBits32(getPixelSeed() ^ mixBits32(dimension + 1));
+    if (dimension >= (int)SobolDimensions)
+        return toUnitFloat(mixBits32((uint32_t)index ^ dimensionSeed));
+    return toUnitFloat(nestedUniformScramble(sobol((uint32_t)index, dimension), dimensionSeed));
+}
+
+Point2f SobolSampler::sampleDimension2D(int64_t index, int dimension) const
+{
+    Float values[4];
+    sampleDimensions(index, dimension, values);
+    return Point2f(values[0], values[1]);
+}
+
+void SobolSampler::sampleDimensions(int64_t index, int dimension, Float values[4]) const
+{
+    const uint32_t pixelSeed = getPixelSeed();
+    uint32_t seeds[4];
+    for (int i = 0; i < 4; ++i)
+        seeds[i] = mixBits32(pixelSeed ^ mixBits32(dimension + i + 1));
+    sobolOwen4((uint32_t)index, dimension, seeds, values);
+}
+
+std::unique_ptr<Sampler> SobolSampler::clone(int seed)
+{
+    // The pixel seed already decorrelates the pixels, clones must give the same values
+    return std::unique_ptr<Sampler>(new SobolSampler(*this));
+}
+
+HaltonSampler::HaltonSampler(const Info &info)
+    : GlobalSampler(info.samplesPerPixel)
+{
+    RNG rng(info.seed);
+    permutations = std::make_shared<const std::vector<uint16_t>>(computeRadicalInversePermutations(rng));
+    permutationOffsets.resize(PrimeTableSize);
+    for (uint32_t i = 0; i < PrimeTableSize; ++i)
+        permutationOffsets[i] = getPrimeSum(i);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        int base = (i == 0) ? 2 : 3;
+        int scale = 1, exp = 0;
+        while (scale < std::min(info.resolution[i], MaxResolution))
+        {
+            scale *= base;
+            ++exp;
+        }
+        baseScales[i] = scale;
+        baseExponents[i] = exp;
+    }
+    sampleStride = baseScales[0] * baseScales[1];
+    multInverse[0] = (int)multiplicativeInverse(baseScales[1], baseScales[0]);
+    multInverse[1] = (int)multiplicativeInverse(baseScales[0], baseScales[1]);
+}
+
+int64_t HaltonSampler::getIndexForSample(int64_t sampleNum) const
+{
+    if (currentPixel != pixelForOffset)
+    {
+        offsetForCurrentPixel = 0;
+        if (sampleStride > 1)
+        {
+            Point2i pm(((currentPixel.x % MaxResolution) + MaxResolution) % MaxResolution,
+                ((currentPixel.y % MaxResolution) + MaxResolution) % MaxResolution);
+            for (int i = 0; i < 2; ++i)
+            {
+                uint64_t dimOffset = inverseRadicalInverse(i == 0 ? 2 : 3, pm[i], baseExponents[i]);
+                offsetForCurrentPixel += dimOffset * (sampleStride / baseScales[i]) * multInverse[i];
+            }
+            offsetForCurrentPixel %= sampleStride;
+        }
+        pixelForOffset = currentPixel;
+    }
+    return offsetForCurrentPixel + sampleNum * sampleStride;
+}
+
+Float HaltonSampler::sampleDimension(int64_t index, int dimension) const
+{
+    if (dimension == 0)
+        return radicalInverse(dimension, index >> baseExponents[0]);
+    else if (dimension == 1)
+        return radicalInverse(dimension, index / baseScales[1]);
+    else if (dimension < (int)PrimeTableSize)
+        return scrambledRadicalInverse(dimension, index, permutations->data() + permutationOffsets[dimension]);
+    return toUnitFloat(mixBits32((uint32_t)index ^ mixBits32((uint32_t)(index >> 32) ^ (dimension + 1))));
+}
+
+std::unique_ptr<Sampler> HaltonSampler::clone(int seed)
+{
+    return std::unique_ptr<Sampler>(new HaltonSampler(*this));
+}
+
+int64_t BlueNoiseSampler::getIndexForSample(int64_t sampleNum) const
+{
+    return sampleNum;
+}
+
+Float BlueNoiseSampler::sampleDimension(int64_t index, int dimension) const
+{
+    return blueNoise1D(currentPixel.x, currentPixel.y, (uint32_t)index, dimension);
+}
+
+Point2f BlueNoiseSampler::sampleDimension2D(int64_t index, int dimension) const
+{
+    return blueNoise2D(currentPixel.x, currentPixel.y, (uint32_t)index, dimension);
+}
+
+std::unique_ptr<Sampler> BlueNoiseSampler::clone(int seed)
+{
+    return std::unique_ptr<Sampler>(new BlueNoiseSampler(*this));
+}
@@ -47,6 +47,34 @@ void atlas::stratifiedSample2D(Point2f *samp, int nx, int ny, RNG &rng, bool jit
         }
 }
 
+void atlas::stratifiedSample1D(Float *samp, int nSamples, RNGStreams &rng, bool jitter)
+{
+    Float invNSamples = (Float)1 / nSamples;
+    if (jitter)
+        rng.uniformFloat(samp, nSamples);
+    for (int i = 0; i < nSamples; ++i)
+    {
+        Float delta = jitter ? samp[i] : 0.5f;
+        samp[i] = std::min((i + delta) * invNSamples, OneMinusEpsilon);
+    }
+}
+
+void atlas::stratifiedSample2D(Point2f *samp, int nx, int ny, RNGStreams &rng, bool jitter)
+{
+    Float dx = (Float)1 / nx, dy = (Float)1 / ny;
+    if (jitter)
+        rng.uniform2D(samp, nx * ny);
+    for (int y = 0; y < ny; ++y)
+        for (int x = 0; x < nx; ++x)
+        {
+            Float jx = jitter ? samp->x : 0.5f;
+            Float jy = jitter ? samp->y : 0.5f;
+            samp->x = std::min((x + jx) * dx, OneMinusEpsilon);
+            samp->y = std::min((y + jy) * dy, OneMinusEpsilon);
+            ++samp;
+        }
+}
+
 void atlas::latinHypercube(Float *samples, int nSamples, int nDim, RNG &rng)
 {
     Float invNSamples = (Float)1 / nSamples;
@@ -24,7 +24,7 @@ atlas::Bounds3f atlas::Triangle::worldBound() const
     return expand(Bounds3f(p0, p1), p2);
 }
 
-bool atlas::Triangle::intersect(const Ray &ray, Float &tHit, SurfaceInteraction &isect, bool testAlphaTexture) const
+bool atlas::Triangle::intersectBarycentric(const Ray &ray, Float &t, Float &b0, Float &b1, Float &b2) const
 {
     // Get triangle vertices in _p0_, _p1_, and _p2_
     const Point3f &p0 = mesh->p[v[0]];
@@ -99,10 +99,10 @@ bool atlas::Triangle::intersect(const Ray &ray, Float &tHit, SurfaceInteraction
 
     // Compute barycentric coordinates and $t$ value for triangle intersection
     Float invDet = 1 / det;
-    Float b0 = e0 * invDet;
-    Float b1 = e1 * invDet;
-    Float b2 = e2 * invDet;
-    Float t = tScaled * invDet;
+    b0 = e0 * invDet;
+    b1 = e1 * invDet;
+    b2 = e2 * invDet;
+    t = tScaled * invDet;
 
     // Ensure that computed triangle $t$ is conservatively greater than zero
 
@@ -126,6 +126,14 @@ bool atlas::Triangle::intersect(const Ray &ray, Float &tHit, SurfaceInteraction
         (gamma(3) * maxE * maxZt + deltaE * maxZt + deltaZ * maxE) *
         std::abs(invDet);
     if (t <= deltaT) return false;
+    return true;
+}
+
+bool atlas::Triangle::computeInteraction(const Ray &ray, Float b0, Float b1, Float b2, SurfaceInteraction &isect) const
+{
+    const Point3f &p0 = mesh->p[v[0]];
+    const Point3f &p1 = mesh->p[v[1]];
+    const Point3f &p2 = mesh->p[v[2]];
 
     // Compute triangle partial derivatives
     Vec3f dpdu, dpdv;
@@ -252,116 +260,26 @@ bool atlas::Triangle::intersect(const Ray &ray, Float &tHit, SurfaceInteraction
         if (reverseOrientation) ts = -ts;
         isect.setShadingGeometry(ss, ts, dndu, dndv, true);
     }
-
-    tHit = t;
     return true;
 }
 
-bool atlas::Triangle::intersectP(const Ray &ray, bool testAlphaTexture) const
+bool atlas::Triangle::intersect(const Ray &ray, Float &tHit, SurfaceInteraction &isect, bool testAlphaTexture) const
 {
-    // Get triangle vertices in _p0_, _p1_, and _p2_
-    const Point3f &p0 = mesh->p[v[0]];
-    const Point3f &p1 = mesh->p[v[1]];
-    const Point3f &p2 = mesh->p[v[2]];
-
-    // Perform ray--triangle intersection test
-
-    // Transform triangle vertices to ray coordinate space
-
-    // Translate vertices based on ray origin
-    Point3f p0t = p0 - Vec3f(ray.origin);
-    Point3f p1t = p1 - Vec3f(ray.origin);
-    Point3f p2t = p2 - Vec3f(ray.origin);
-
-    // Permute components of triangle vertices and ray direction
-    int kz = abs(ray.dir).maxDimension();
-    int kx = kz + 1;
-    if (kx == 3) kx = 0;
-    int ky = kx + 1;
-    if (ky == 3) ky = 0;
-    Vec3f d = permute(ray.dir, kx, ky, kz);
-    p0t = permute(p0t, kx, ky, kz);
-    p1t = permute(p1t, kx, ky, kz);
-    p2t = permute(p2t, kx, ky, kz);
-
-    // Apply shear transformation to translated vertex positions
-    Float Sx = -d.x / d.z;
-    Float Sy = -d.y / d.z;
-    Float Sz = 1.f / d.z;
-    p0t.x += Sx * p0t.z;
-    p0t.y += Sy * p0t.z;
-    p1t.x += Sx * p1t.z;
-    p1t.y += Sy * p1t.z;
-    p2t.x += Sx * p2t.z;
-    p2t.y += Sy * p2t.z;
-
-    // Compute edge function coefficients _e0_, _e1_, and _e2_
-    Float e0 = p1t.x * p2t.y - p1t.y * p2t.x;
-    Float e1 = p2t.x * p0t.y - p2t.y * p0t.x;
-    Float e2 = p0t.x * p1t.y - p0t.y * p1t.x;
-
-    // Fall back to double precision test at triangle edges
-    if (sizeof(Float) == sizeof(float) &&
-        (e0 == 0.0f || e1 == 0.0f || e2 == 0.0f)) {
-        double p2txp1ty = (double)p2t.x * (double)p1t.y;
-        double p2typ1tx = (double)p2t.y * (double)p1t.x;
-        e0 = (float)(p2typ1tx - p2txp1ty);
-        double p0txp2ty = (double)p0t.x * (double)p2t.y;
-        double p0typ2tx = (double)p0t.y * (double)p2t.x;
-        e1 = (float)(p0typ2tx - p0txp2ty);
-        double p1txp0ty = (double)p1t.x * (double)p0t.y;
-        double p1typ0tx = (double)p1t.y * (double)p0t.x;
-        e2 = (float)(p1typ0tx - p1txp0ty);
-    }
-
-    // Perform triangle edge and determinant tests
-    if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0))
-        return false;
-    Float det = e0 + e1 + e2;
-    if (det == 0) return false;
-
-    // Compute scaled hit distance to triangle and test against ray $t$ range
-    p0t.z *= Sz;
-    p1t.z *= Sz;
-    p2t.z *= Sz;
-    Float tScaled = e0 * p0t.z + e1 * p1t.z + e2 * p2t.z;
-    if (det < 0 && (tScaled >= 0 || tScaled < ray.tmax * det))
+    Float t, b0, b1, b2;
+    if (!intersectBarycentric(ray, t, b0, b1, b2))
         return false;
-    else if (det > 0 && (tScaled <= 0 || tScaled > ray.tmax * det))
+    if (!computeInteraction(ray, b0, b1, b2, isect))
         return false;
-
-    // Compute barycentric coordinates and $t$ value for triangle intersection
-    Float invDet = 1 / det;
-    Float b0 = e0 * invDet;
-    Float b1 = e1 * invDet;
-    Float b2 = e2 * invDet;
-    Float t = tScaled * invDet;
-
-    // Ensure that computed triangle $t$ is conservatively greater than zero
-
-    // Compute $\delta_z$ term for triangle $t$ error bounds
-    Float maxZt = abs(Vec3f(p0t.z, p1t.z, p2t.z)).maxComponent();
-    Float deltaZ = gamma(3) * maxZt;
-
-    // Compute $\delta_x$ and $\delta_y$ terms for triangle $t$ error bounds
-    Float maxXt = abs(Vec3f(p0t.x, p1t.x, p2t.x)).maxComponent();
-    Float maxYt = abs(Vec3f(p0t.y, p1t.y, p2t.y)).maxComponent();
-    Float deltaX = gamma(5) * (maxXt + maxZt);
-    Float deltaY = gamma(5) * (maxYt + maxZt);
-
-    // Compute $\delta_e$ term for triangle $t$ error bounds
-    Float deltaE =
-        2 * (gamma(2) * maxXt * maxYt + deltaY * maxXt + deltaX * maxYt);
-
-    // Compute $\delta_t$ term for triangle $t$ error bounds and check _t_
-    Float maxE = abs(Vec3f(e0, e1, e2)).maxComponent();
-    Float deltaT = 3 *
-        (gamma(3) * maxE * maxZt + deltaE * maxZt + deltaZ * maxE) *
-        std::abs(invDet);
-    if (t <= deltaT) return false;
+    tHit = t;
     return true;
 }
 
+bool atlas::Triangle::intersectP(const Ray &ray, bool testAlphaTexture) const
+{
+    Float t, b0, b1, b2;
+    return intersectBarycentric(ray, t, b0, b1, b2);
+}
+
 Float atlas::Triangle::area() const
 {
     // Get triangle vertices in _p0_, _p1_, and _p2_
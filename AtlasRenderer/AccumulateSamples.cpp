@@ -0,0 +1,26 @@
+#include "AccumulateSamples.h"
+
+bool atlas::task::AccumulateSamples::preExecute()
+{
+	return (data.buckets->getSlotCount() > 0);
+}
+
+void atlas::task::AccumulateSamples::execute()
+{
+	const uint32_t slotCount = data.buckets->getSlotCount();
+	while (true)
+	{
+		const uint32_t bucket = bucketIdx.fetch_add(1);
+		if (bucket >= data.buckets->getBucketCount())
+			break;
+
+		for (uint32_t slot = 0; slot < slotCount; slot++)
+		{
+			for (const Sample &sample : data.buckets->getSamples(slot, bucket))
+				data.iteration->addSample(sample.pixelID, sample.color);
+		}
+	}
+}
+
+void atlas::task::AccumulateSamples::postExecute()
+{}
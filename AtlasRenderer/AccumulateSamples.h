@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+
+#include "atlas/core/FilmIterator.h"
+
+#include "SampleBuckets.h"
+#include "ThreadPool.h"
+
+namespace atlas
+{
+	namespace task
+	{
+		// Adds the samples of the shading threads to the film, each thread owns a range of pixels
+		class AccumulateSamples : public ThreadedTask
+		{
+		public:
+			struct Data
+			{
+				const SampleBuckets *buckets = nullptr;
+				FilmIterator *iteration = nullptr;
+			};
+
+			AccumulateSamples(Data &data)
+				: data(data)
+			{}
+
+			bool preExecute() override;
+			void execute() override;
+			void postExecute() override;
+
+		private:
+			Data data;
+
+			std::atomic<uint32_t> bucketIdx = 0;
+		};
+	}
+}
@@ -1,21 +1,45 @@
 #include "Acheron.h"
 
+#include <fstream>
 #include <string>
 
 #include "atlas/core/FilmIterator.h"
 #include "atlas/core/Telemetry.h"
 
+#include "AccumulateSamples.h"
+#include "Denoise.h"
 #include "GenerateFirstRays.h"
 #include "ExtractBatch.h"
 #include "SortRays.h"
 #include "traceRays.h"
 #include "ShadeInteractions.h"
+#include "TraceShadowRays.h"
+#include "TraceSmallBatch.h"
 
 #include "BSDF.h"
+#include "ImageLibrary.h"
 #include "Material.h"
 
 using namespace atlas;
 
+namespace
+{
+	const char *checkpointFilename = "render.checkpoint";
+	const char *partialCheckpointFilename = "render.checkpoint.part";
+	constexpr uint32_t checkpointMagic = 0x4B484341; // "ACHK"
+	constexpr uint32_t checkpointVersion = 1;
+
+	struct CheckpointHeader
+	{
+		uint32_t magic = checkpointMagic;
+		uint32_t version = checkpointVersion;
+		Point2i resolution;
+		uint32_t nextSample = 0;
+		uint32_t sppStep = 1;
+		Float elapsed = 0;
+	};
+}
+
 Acheron::Acheron(const Info &info)
 	: samplePerPixel(info.samplePerPixel)
 	, minLightBounce(info.minLightBounce)
@@ -23,15 +47,32 @@ Acheron::Acheron(const Info &info)
 	, lightTreshold(info.lightTreshold)
 	, tmin(info.tmin), tmax(info.tmax)
 	, batchManager(info.batchSize)
-	, sampler(*info.sampler)
+	, blueNoise(info.blueNoise)
+	// The samples of a batch come from the shading and then from its shadow rays, each task takes one slot per thread
+	, sampleBuckets(2 * (info.threadCount + 1))
+	, shadowRays(info.threadCount + 1)
 	, smallBatchTreshold(info.smallBatchTreshold)
 	, localBinSize(info.localBinSize)
 	, batchSize(info.batchSize)
 	, temporaryDir(std::filesystem::absolute(info.temporaryFolder))
 	, assetDir(std::filesystem::absolute(info.assetFolder))
+	, checkpointInterval(info.checkpointInterval)
+	, snapshotInterval(info.snapshotInterval)
+	, errorThreshold(info.errorThreshold)
+	, adaptiveMinSamples(info.adaptiveMinSamples)
+	, adaptiveMinIterations(info.adaptiveMinIterations)
+	, timeBudget(info.timeBudget)
+	, denoiseFilm(info.denoise)
+	, denoisePasses(info.denoisePasses)
+	, denoiseSigma(info.denoiseSigma)
 	, endOfIterationCallback(info.endOfIterationCallback)
 	, console(*info.console)
 {
+	if (samplePerPixel > MaxSamplePerPixel)
+	{
+		console << samplePerPixel << " samples per pixel requested, clamped to " << MaxSamplePerPixel << std::endl;
+		samplePerPixel = MaxSamplePerPixel;
+	}
 	threads.init(info.threadCount);
 }
 
@@ -41,47 +82,214 @@ Acheron::~Acheron()
 }
 
 void Acheron::render(const Camera &camera, const Primitive &scene, Film &film)
+{
+	renderFrom(camera, scene, film, false);
+}
+
+bool Acheron::resume(const Camera &camera, const Primitive &scene, Film &film)
+{
+	return (renderFrom(camera, scene, film, true));
+}
+
+void Acheron::render(const Camera &camera, const Primitive &scene, const std::vector<std::shared_ptr<Light>> &lights, Film &film)
+{
+	this->lights = &lights;
+	renderFrom(camera, scene, film, false);
+	this->lights = nullptr;
+}
+
+bool Acheron::resume(const Camera &camera, const Primitive &scene, const std::vector<std::shared_ptr<Light>> &lights, Film &film)
+{
+	this->lights = &lights;
+	const bool resumed = renderFrom(camera, scene, film, true);
+	this->lights = nullptr;
+	return (resumed);
+}
+
+void Acheron::requestCheckpoint()
+{
+	checkpointRequested = true;
+}
+
+bool Acheron::renderFrom(const Camera &camera, const Primitive &scene, Film &film, bool resume)
 {
 	TELEMETRY(achRender, "Acheron/render");
 
 	prepareTemporaryDir();
 	batch.reserve(batchSize);
+	aovFilm = film.hasAovs() ? &film : nullptr;
+	pixelCount = film.resolution.x * film.resolution.y;
 
+	uint32_t firstSample = 0;
 	uint32_t sppStep = 1;
+	Float previousElapsed = 0;
 	FilmIterator iteration = film.createIterator();
-	for (uint32_t i = 0; i < samplePerPixel; i += sppStep)
+	iteration.setSnapshotInterval(snapshotInterval);
+	const bool resumed = resume && readCheckpoint(film, iteration, firstSample, sppStep, previousElapsed);
+	if (resume && !resumed)
+	{
+		console << "No checkpoint to resume from, starting over" << std::endl;
+		film.clear();
+	}
+	activePixels = iteration.getActivePixels();
+	const auto startTime = std::chrono::steady_clock::now()
+		- std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<Float>(previousElapsed));
+
+	bool interrupted = false;
+	for (uint32_t i = firstSample; i < samplePerPixel; i += sppStep)
 	{
 		sppStep = std::min(sppStep * 2, 16u);
 		uint32_t currentSpp = i + sppStep <= samplePerPixel ? sppStep : samplePerPixel - i;
 		console << "i " << i << " sppStep " << sppStep << " currentSpp " << currentSpp << " samplePerPixel " << samplePerPixel << std::endl;
 
 		iteration.start(currentSpp);
+		sampleOffset = i;
 		renderIteration(camera, scene, film, iteration);
+		iteration.merge();
 		if (endOfIterationCallback)
 			endOfIterationCallback(film.resolution, iteration);
+
+		if (errorThreshold > 0 && i + currentSpp >= adaptiveMinSamples)
+		{
+			const uint32_t unconvergedCount = iteration.updateActivePixels(errorThreshold, adaptiveMinIterations);
+			activePixels = iteration.getActivePixels();
+			console << "unconverged pixels " << unconvergedCount << " / " << pixelCount << std::endl;
+			if (unconvergedCount == 0)
+				break;
+		}
+
+		const std::chrono::duration<Float> elapsed = std::chrono::steady_clock::now() - startTime;
+		interrupted = checkpointRequested.exchange(false);
+		bool saved = false;
+		if (interrupted || (checkpointInterval && iteration.getIterationCount() % checkpointInterval == 0))
+			saved = writeCheckpoint(film, iteration, i + sppStep, sppStep, elapsed.count());
+		if (interrupted)
+		{
+			if (saved)
+				console << "Checkpoint saved after " << i + currentSpp << " samples per pixel" << std::endl;
+			break;
+		}
+
+		if (timeBudget > 0 && elapsed.count() >= timeBudget)
+			break;
 	}
+	activePixels = nullptr;
 	iteration.accumulate();
+	if (!interrupted && std::filesystem::exists(checkpointFilename))
+		std::filesystem::remove(checkpointFilename);
+	if (denoiseFilm && !interrupted)
+	{
+		std::vector<Spectrum> colors(pixelCount);
+		denoise(film.resolution, iteration, colors.data(), aovFilm);
+		for (uint32_t i = 0; i < pixelCount; i++)
+		{
+			film.getPixel(i).color = colors[i];
+			film.getPixel(i).filterWeightSum = 1;
+		}
+	}
+	aovFilm = nullptr;
 	restoreExecutionDir();
 	batch.clear();
+	return (resumed);
 }
 
-void Acheron::renderIteration(const Camera &camera, const Primitive &scene, const Film &film, FilmIterator &iteration)
+bool Acheron::writeCheckpoint(const Film &film, const FilmIterator &iteration, uint32_t nextSample, uint32_t sppStep, Float elapsed)
 {
-	TELEMETRY(achIteration, "Acheron/render/iteration");
+	TELEMETRY(achCheckpoint, "Acheron/render/checkpoint");
+
+	CheckpointHeader header;
+	header.resolution = film.resolution;
+	header.nextSample = nextSample;
+	header.sppStep = sppStep;
+	header.elapsed = elapsed;
+
+	// Written aside then renamed, a preemption while writing leaves the previous checkpoint intact
+	std::ofstream file(partialCheckpointFilename, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	film.writeAovs(file);
+	iteration.write(file);
+	// A full disk may only show up when the end of the buffer is flushed
+	file.close();
+
+	std::error_code error;
+	if (!file)
 	{
-		TELEMETRY(achGenFirstRays, "Acheron/render/iteration/generateFirstRays");
-		task::GenerateFirstRays::Data data;
-		data.resolution = film.resolution;
-		data.spp = iteration.getSampleCount();
-		data.camera = &camera;
-		data.localBinSize = localBinSize;
-		data.sampler = &sampler;
-		data.batchManager = &batchManager;
-		threads.execute<task::GenerateFirstRays>(data);
-		threads.join();
+		console << "Could not write the checkpoint to " << partialCheckpointFilename << std::endl;
+		std::filesystem::remove(partialCheckpointFilename, error);
+		return (false);
 	}
+	std::filesystem::rename(partialCheckpointFilename, checkpointFilename, error);
+	if (error)
+	{
+		console << "Could not rename the checkpoint: " << error.message() << std::endl;
+		std::filesystem::remove(partialCheckpointFilename, error);
+		return (false);
+	}
+	return (true);
+}
+
+bool Acheron::readCheckpoint(Film &film, FilmIterator &iteration, uint32_t &nextSample, uint32_t &sppStep, Float &elapsed)
+{
+	std::ifstream file(checkpointFilename, std::ios::binary);
+	if (!file.is_open())
+		return (false);
+
+	CheckpointHeader header;
+	file.read(reinterpret_cast<char *>(&header), sizeof(header));
+	if (!file || header.magic != checkpointMagic || header.version != checkpointVersion
+		|| header.resolution.x != film.resolution.x || header.resolution.y != film.resolution.y)
+		return (false);
+	if (!film.readAovs(file) || !iteration.read(file))
+		return (false);
+
+	nextSample = header.nextSample;
+	sppStep = header.sppStep;
+	elapsed = header.elapsed;
+	console << "Resuming at " << nextSample << " samples per pixel" << std::endl;
+	return (true);
+}
+
+void Acheron::renderIteration(const Camera &camera, const Primitive &scene, const Film &film, FilmIterator &iteration)
+{
+	TELEMETRY(achIteration, "Acheron/render/iteration");
+	filmWidth = film.resolution.x;
+	pixelCount = film.resolution.x * film.resolution.y;
+
+	cameraRays.camera = &camera;
+	cameraRays.resolution = film.resolution;
+	cameraRays.spp = iteration.getSampleCount();
+	cameraRays.zOrderPos = 0;
+	cameraRays.zOrderEnd = posToZOrderIndex(film.resolution.x, film.resolution.y);
+	generateCameraRays(true);
 
 	processBatches(scene, iteration);
+	cameraRays.camera = nullptr;
+}
+
+void Acheron::generateCameraRays(bool firstRange)
+{
+	TELEMETRY(achGenFirstRays, "Acheron/render/iteration/generateFirstRays");
+
+	// About one batch of camera rays, in whole steps of the task so that two ranges never overlap
+	const uint64_t step = task::GenerateFirstRays::zOrderStep;
+	const uint64_t pixels = std::max(batchSize / std::max(cameraRays.spp, 1u), 1u);
+	const uint64_t count = (pixels + step - 1) / step * step;
+
+	task::GenerateFirstRays::Data data;
+	data.resolution = cameraRays.resolution;
+	data.spp = cameraRays.spp;
+	data.firstSample = sampleOffset;
+	data.blueNoise = blueNoise;
+	data.activePixels = activePixels;
+	data.camera = cameraRays.camera;
+	data.localBinSize = localBinSize;
+	data.batchManager = &batchManager;
+	data.zOrderBegin = cameraRays.zOrderPos;
+	data.zOrderEnd = std::min(cameraRays.zOrderPos + count, cameraRays.zOrderEnd);
+	data.openBins = firstRange;
+	cameraRays.zOrderPos = data.zOrderEnd;
+	threads.execute<task::GenerateFirstRays>(data);
+	threads.join();
 }
 
 void Acheron::processBatches(const Primitive &scene, FilmIterator &iteration)
@@ -90,6 +298,11 @@ void Acheron::processBatches(const Primitive &scene, FilmIterator &iteration)
 	{
 		TELEMETRY(achProcessBatch, "acheron/render/processBatches");
 
+		// Path regeneration, new camera rays are added as soon as no full batch is left so that the
+		// batches only shrink once the camera rays of the iteration are exhausted
+		while (cameraRays.camera && cameraRays.zOrderPos < cameraRays.zOrderEnd && !batchManager.hasPendingBatch())
+			generateCameraRays(false);
+
 		Block<SurfaceInteraction> interactions(batchSize);
 
 		{
@@ -162,9 +375,6 @@ void Acheron::processBatches(const Primitive &scene, FilmIterator &iteration)
 		{
 			TELEMETRY(achShading, "acheron/render/processBatches/shading");
 
-			std::mutex samplesGuard;
-			std::vector<Sample> samples;
-
 			const uint32_t maxItPerPack = 512;
 			std::vector<ShadingPack> shadingPack(1);
 			shadingPack[0].start = 0;
@@ -185,18 +395,23 @@ void Acheron::processBatches(const Primitive &scene, FilmIterator &iteration)
 			bool hasTask = shadingPack.front().material || shadingPack.size() > 1;
 			if (hasTask)
 			{
+				sampleBuckets.reset(pixelCount);
+				shadowRays.reset();
 				task::ShadeInteractions::Data data;
 				data.startingIndex = shadingPack.front().material ? 0 : 1;
 				data.maxDepth = maxLightBounce;
 				data.tmin = tmin;
 				data.lightTreshold = lightTreshold;
+				data.blueNoise = blueNoise;
+				data.filmWidth = filmWidth;
 				data.localBinSize = localBinSize;
 				data.batch = &batch;
 				data.interactions = &interactions;
 				data.shadingPack = &shadingPack;
-				data.sampler = &sampler;
-				data.samples = &samples;
-				data.samplesGuard = &samplesGuard;
+				data.buckets = &sampleBuckets;
+				data.aovs = aovFilm;
+				data.lights = lights;
+				data.shadowRays = &shadowRays;
 				data.batchManager = &batchManager;
 				threads.execute<task::ShadeInteractions>(data);
 			}
@@ -254,52 +469,119 @@ void Acheron::processBatches(const Primitive &scene, FilmIterator &iteration)
 					Float t = (Float)0.5 * (unitDir.y + (Float)1.0);
 					Spectrum color(((Float)1.0 - t) * atlas::Spectrum(1.f) + t * atlas::Spectrum((Float)0.5, (Float)0.7, (Float)1.0));
 					iteration.addSample(batch.pixelIDs[i], batch.colors[i] * color);
+					if (aovFilm && batch.depths[i] == 0 && batch.sampleIDs[i] == 0)
+						aovFilm->setAovs(batch.pixelIDs[i], color, -unitDir, INFINITY, 0);
 				}
 			}
 
 			if (hasTask)
 			{
 				threads.join();
+				ImageLibrary::releaseRetiredTiles();
+				ImageLibrary::flushStatistics();
 
-				for (Sample &sample : samples)
+				if (lights)
 				{
-					iteration.addSample(sample.pixelID, sample.color);
+					TELEMETRY(achShadowRays, "acheron/render/processBatches/shading/traceShadowRays");
+					task::TraceShadowRays::Data data;
+					data.queue = &shadowRays;
+					data.scene = &scene;
+					data.buckets = &sampleBuckets;
+					threads.execute<task::TraceShadowRays>(data);
+					threads.join();
 				}
+
+				TELEMETRY(achAccumulate, "acheron/render/processBatches/shading/accumulate");
+				task::AccumulateSamples::Data data;
+				data.buckets = &sampleBuckets;
+				data.iteration = &iteration;
+				threads.execute<task::AccumulateSamples>(data);
+				threads.join();
 			}
 		}
 	}
 }
 
-Spectrum Acheron::getColorAlongRay(const atlas::Ray &r, const atlas::Primitive &scene, atlas::Sampler &sampler, uint32_t depth)
+void Acheron::denoise(const Point2i &resolution, const FilmIterator &iterator, Spectrum *colors, const Film *features)
 {
-	if (depth >= maxLightBounce)
-		return (atlas::Spectrum(0.f));
+	TELEMETRY(achDenoise, "Acheron/denoise");
+
+	const uint32_t count = resolution.x * resolution.y;
+	std::vector<Spectrum> tmpColors(count);
+	std::vector<Float> variances[2] = { std::vector<Float>(count), std::vector<Float>(count) };
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Film::Pixel &pixel = iterator.getPixel(i);
+		colors[i] = pixel.filterWeightSum > 0 ? pixel.color / pixel.filterWeightSum : Spectrum(0.f);
+		// Pixels with a single iteration have no estimate, they are assumed to be fully noisy
+		const Float variance = iterator.getPixelVariance(i);
+		variances[0][i] = std::isinf(variance) ? luminance(colors[i]) * luminance(colors[i]) : variance;
+	}
+
+	std::vector<Normal> normals;
+	if (features && features->hasAov(AovFlags::Normal))
+	{
+		normals.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			normals[i] = features->getNormal(i);
+	}
+	std::vector<Float> depths;
+	if (features && features->hasAov(AovFlags::Depth))
+	{
+		depths.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			depths[i] = features->getDepth(i);
+	}
 
-	atlas::SurfaceInteraction s;
-	if (scene.intersect(r, s))
+	// The passes alternate between the two buffers, an extra copy brings the result back when their count is odd
+	Spectrum *buffers[2] = { colors, tmpColors.data() };
+	for (uint32_t pass = 0; pass < denoisePasses; pass++)
 	{
-		atlas::BSDFSample bsdf = s.material->sample(-r.dir, s, sampler.get2D());
-		if (luminance(bsdf.Li) < lightTreshold)
-			return (bsdf.Le);
-		return (bsdf.Le + /* bsdf.pdf * */ bsdf.Li * getColorAlongRay(atlas::Ray(s.p, bsdf.wi), scene, sampler, depth + 1));
+		task::Denoise::Data data;
+		data.resolution = resolution;
+		data.step = 1 << pass;
+		data.sigmaLuminance = denoiseSigma;
+		data.srcColors = buffers[pass & 1];
+		data.srcVariances = variances[pass & 1].data();
+		data.dstColors = buffers[(pass + 1) & 1];
+		data.dstVariances = variances[(pass + 1) & 1].data();
+		data.normals = normals.empty() ? nullptr : normals.data();
+		data.depths = depths.empty() ? nullptr : depths.data();
+		threads.execute<task::Denoise>(data);
+		threads.join();
 	}
-	atlas::Vec3f unitDir = normalize(r.dir);
-	auto t = (Float)0.5 * (unitDir.y + (Float)1.0);
-	return (((Float)1.0 - t) * atlas::Spectrum(1) + t * atlas::Spectrum((Float)0.5, (Float)0.7, (Float)1.0));
+	if (denoisePasses & 1)
+		std::copy(tmpColors.begin(), tmpColors.end(), colors);
 }
 
 void Acheron::processSmallBatches(const Primitive &scene, FilmIterator &iteration)
 {
 	while (batch.size())
 	{
-		console << "Small batch " << batch.size() << std::endl;
 		TELEMETRY(achrSmallBatches, "acheron/render/processBatches/smallBatches");
-		for (uint32_t i = 0; i < batch.size(); i++)
+		sampleBuckets.reset(pixelCount);
 		{
-			sampler.startPixel(Point2i(0, 0));
-			Ray r(batch.origins[i], batch.directions[i]);
-			Spectrum color = batch.colors[i] * getColorAlongRay(r, scene, sampler, batch.depths[i]);
-			iteration.addSample(batch.pixelIDs[i], color);
+			task::TraceSmallBatch::Data data;
+			data.maxDepth = maxLightBounce;
+			data.tmin = tmin;
+			data.lightTreshold = lightTreshold;
+			data.blueNoise = blueNoise;
+			data.filmWidth = filmWidth;
+			data.batch = &batch;
+			data.scene = &scene;
+			data.lights = lights;
+			data.aovs = aovFilm;
+			data.buckets = &sampleBuckets;
+			threads.execute<task::TraceSmallBatch>(data);
+			threads.join();
+		}
+
+		{
+			task::AccumulateSamples::Data data;
+			data.buckets = &sampleBuckets;
+			data.iteration = &iteration;
+			threads.execute<task::AccumulateSamples>(data);
+			threads.join();
 		}
 
 		{
@@ -318,7 +600,7 @@ void Acheron::prepareTemporaryDir()
 	{
 		for (const auto &entry : std::filesystem::directory_iterator(temporaryDir))
 		{
-			if (entry.path().extension() == "tmp")
+			if (entry.path().extension() == ".tmp")
 				std::filesystem::remove_all(entry.path());
 		}
 	}
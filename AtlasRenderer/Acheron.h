@@ -1,25 +1,31 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <filesystem>
 #include <iostream>
 
 #include "Atlas/core/Camera.h"
 #include "Atlas/core/Film.h"
+#include "Atlas/core/Light.h"
 #include "Atlas/core/Primitive.h"
-#include "Atlas/core/Sampler.h"
 
 #include "AtlasRendererLibHeader.h"
 #include "ThreadPool.h"
 #include "Bin.h"
 #include "atlas/core/Batch.h"
 #include "BatchManager.h"
+#include "SampleBuckets.h"
+#include "ShadowRayQueue.h"
 
 namespace atlas
 {
 	class Acheron
 	{
 	public:
+		// CompactRay and Batch hold the index of the sample on 16 bits
+		static constexpr uint32_t MaxSamplePerPixel = 65536;
 
 		struct Info
 		{
@@ -30,7 +36,8 @@ namespace atlas
 			Float tmax = INFINITY;
 			Float lightTreshold  = (Float)0.01;
 
-			Sampler *sampler;
+			// Blue noise dithered samples instead of white noise, cleaner at low sample counts
+			bool blueNoise = false;
 
 			std::string temporaryFolder = "./";
 			std::string assetFolder = "./";
@@ -41,6 +48,26 @@ namespace atlas
 
 			uint32_t threadCount = std::thread::hardware_concurrency() - 1;
 
+			// Pixels whose relative standard error falls below errorThreshold stop receiving samples once
+			// they got adaptiveMinSamples over adaptiveMinIterations, 0 samples every pixel up to samplePerPixel
+			Float errorThreshold = 0;
+			uint32_t adaptiveMinSamples = 16;
+			uint32_t adaptiveMinIterations = 8;
+			// The render stops after the iteration that exceeds it, in seconds, 0 for no limit
+			Float timeBudget = 0;
+
+			// Edge-aware a-trous filter applied to the film once the render is done
+			bool denoise = false;
+			uint32_t denoisePasses = 5;
+			Float denoiseSigma = 4;
+
+			// Iterations between two checkpoints saved to the temporary folder, 0 only saves them on request
+			uint32_t checkpointInterval = 0;
+
+			// Iterations between two snapshots of the accumulated image saved to the temporary folder, 0 disables them
+			uint32_t snapshotInterval = 0;
+
+			// Called once the iteration has been merged, the iterator gives the image converged so far
 			std::function<void(const atlas::Point2i &resolution, const atlas::FilmIterator &iterator)> endOfIterationCallback;
 
 			std::ostream *console = &std::cout;
@@ -50,14 +77,26 @@ namespace atlas
 		ATLAS_RENDERER ~Acheron();
 
 		ATLAS_RENDERER void render(const Camera &camera, const Primitive &scene, Film &film);
+		// Continues the render from the checkpoint of the temporary folder, starts it over when there
+		// is no checkpoint matching the film. Returns true when it resumed.
+		ATLAS_RENDERER bool resume(const Camera &camera, const Primitive &scene, Film &film);
+		// Same as above with next event estimation, every shading point samples one of the lights
+		ATLAS_RENDERER void render(const Camera &camera, const Primitive &scene, const std::vector<std::shared_ptr<Light>> &lights, Film &film);
+		ATLAS_RENDERER bool resume(const Camera &camera, const Primitive &scene, const std::vector<std::shared_ptr<Light>> &lights, Film &film);
+		// Safe to call from any thread or from a signal handler. The render saves a checkpoint once
+		// its current iteration is done and returns, resume() picks it up.
+		ATLAS_RENDERER void requestCheckpoint();
 		ATLAS_RENDERER void renderIteration(const Camera &camera, const Primitive &scene, const Film &film, FilmIterator &iteration);
 		ATLAS_RENDERER void processBatches(const Primitive &scene, FilmIterator &iteration);
 		
 		ATLAS_RENDERER void prepareTemporaryDir();
 		ATLAS_RENDERER void restoreExecutionDir();
 
+		// Writes the denoised and normalized colors of the image converged so far, can be called from endOfIterationCallback
+		// The normal and depth AOVs of features, when it has them, guide the filter
+		ATLAS_RENDERER void denoise(const Point2i &resolution, const FilmIterator &iterator, Spectrum *colors, const Film *features = nullptr);
+
 		ATLAS_RENDERER void processSmallBatches(const Primitive &scene, FilmIterator &iteration);
-		ATLAS_RENDERER Spectrum getColorAlongRay(const atlas::Ray &r, const atlas::Primitive &scene, atlas::Sampler &sampler, uint32_t depth);
 
 		// atlas::Film film(filmInfo);
 
@@ -71,6 +110,13 @@ namespace atlas
 		// FilmInfo, bvh, sampler
 
 	private:
+		bool renderFrom(const Camera &camera, const Primitive &scene, Film &film, bool resume);
+		// Generates the next range of camera rays of the iteration
+		void generateCameraRays(bool firstRange);
+		// Taken between two iterations, the bins are empty and the film holds the whole render state
+		bool writeCheckpoint(const Film &film, const FilmIterator &iteration, uint32_t nextSample, uint32_t sppStep, Float elapsed);
+		bool readCheckpoint(Film &film, FilmIterator &iteration, uint32_t &nextSample, uint32_t &sppStep, Float &elapsed);
+
 		uint32_t samplePerPixel = 16;
 		uint32_t minLightBounce = 0; // unused for now
 		uint32_t maxLightBounce = 9;
@@ -82,7 +128,24 @@ namespace atlas
 		Batch batch;
 		//Block<SurfaceInteraction> interactions;
 
-		Sampler &sampler;
+		// Samples of the previous iterations, the sample indices of the current one start there
+		uint32_t sampleOffset = 0;
+		bool blueNoise = false;
+		uint32_t filmWidth = 0;
+		uint32_t pixelCount = 0;
+		SampleBuckets sampleBuckets;
+		const std::vector<std::shared_ptr<Light>> *lights = nullptr;
+		ShadowRayQueue shadowRays;
+
+		// Camera rays of the current iteration, generated by ranges of z-order indices when the bins run low
+		struct
+		{
+			const Camera *camera = nullptr;
+			Point2i resolution;
+			uint32_t spp = 0;
+			uint64_t zOrderPos = 0;
+			uint64_t zOrderEnd = 0;
+		} cameraRays;
 
 		ThreadPool<8> threads;
 
@@ -94,6 +157,19 @@ namespace atlas
 		const std::filesystem::path temporaryDir = "./";
 		const std::filesystem::path assetDir = "./";
 
+		uint32_t snapshotInterval = 0;
+		Float errorThreshold = 0;
+		uint32_t adaptiveMinSamples = 16;
+		uint32_t adaptiveMinIterations = 8;
+		Float timeBudget = 0;
+		bool denoiseFilm = false;
+		uint32_t denoisePasses = 5;
+		Float denoiseSigma = 4;
+		const uint8_t *activePixels = nullptr;
+		Film *aovFilm = nullptr;
+		uint32_t checkpointInterval = 0;
+		std::atomic<bool> checkpointRequested = false;
+
 		std::function<void(const atlas::Point2i &resolution, const atlas::FilmIterator &iterator)> endOfIterationCallback;
 
 		std::ostream &console;
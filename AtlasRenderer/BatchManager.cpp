@@ -99,6 +99,7 @@ void BatchManager::postBatchAsActive(const std::string &batchName)
 		file << batchName << "\n";
 		file.close();
 	}
+	pendingBatches++;
 	locker.unlock();
 }
 
@@ -131,6 +132,8 @@ std::string BatchManager::popBatchName()
 			newFile.close();
 		}
 	}
+	if (!batchName.empty())
+		pendingBatches--;
 	return (batchName);
 }
 
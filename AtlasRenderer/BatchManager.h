@@ -27,6 +27,12 @@ namespace atlas
 
 		Bin *getUncompledBatch();
 
+		// A full bin is waiting to be extracted
+		inline bool hasPendingBatch() const
+		{
+			return (pendingBatches > 0);
+		}
+
 		inline uint32_t getBinSize() const
 		{
 			return (binSize);
@@ -37,6 +43,7 @@ namespace atlas
 
 		std::mutex locker;
 		std::atomic<uint32_t> nbrBatch = 0;
+		std::atomic<uint32_t> pendingBatches = 0;
 		std::array<Bin, 6> bins;
 	};
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Atlas/Atlas.h"
+#include "Atlas/core/Half.h"
 #include "Atlas/core/Points.h"
 #include "Atlas/core/Ray.h"
 #include "Atlas/core/RgbSpectrum.h"
@@ -45,14 +46,17 @@ namespace atlas
 		uint32_t weight;
 		uint32_t pixelID;
 		uint16_t sampleID;
-		uint16_t depth; // suppose to be ray diameter
+		uint16_t depth;
 		float tNear;
+		// Ray cone used to filter textures, width at the origin and spread angle, stored as half
+		uint16_t coneWidth;
+		uint16_t coneSpread;
 
 		CompactRay()
-			: origin(0), direction(0), weight(0), pixelID(0), sampleID(0), depth(0), tNear(0)
+			: origin(0), direction(0), weight(0), pixelID(0), sampleID(0), depth(0), tNear(0), coneWidth(0), coneSpread(0)
 		{};
 
-		CompactRay(const Ray &ray, const Spectrum &color, uint32_t pixel, uint32_t sample, uint32_t depth, float tNear = 0)
+		CompactRay(const Ray &ray, const Spectrum &color, uint32_t pixel, uint32_t sample, uint32_t depth, float tNear = 0, float width = 0, float spread = 0)
 			: origin(ray.origin)
 			, direction(octEncode(ray.dir))
 			, weight(toRgb9e5(color))
@@ -60,6 +64,8 @@ namespace atlas
 			, sampleID(sample)
 			, depth(depth)
 			, tNear(tNear)
+			, coneWidth(toHalf(width))
+			, coneSpread(toHalf(spread))
 		{
 			if (color.isBlack())
 			{
@@ -68,7 +74,7 @@ namespace atlas
 			}
 		}
 
-		CompactRay(const Ray &ray, uint32_t pixel, uint32_t sample, float tNear = 0)
+		CompactRay(const Ray &ray, uint32_t pixel, uint32_t sample, float tNear = 0, float width = 0, float spread = 0)
 			: origin(ray.origin)
 			, direction(octEncode(ray.dir))
 			, weight(toRgb9e5(Spectrum(1.f)))
@@ -76,6 +82,8 @@ namespace atlas
 			, sampleID(sample)
 			, depth(0)
 			, tNear(tNear)
+			, coneWidth(toHalf(width))
+			, coneSpread(toHalf(spread))
 		{
 			if (weight == 0)
 			{
@@ -106,5 +114,27 @@ namespace atlas
 		//	tNear = ray.tNear;
 		//}
 	};
+
+	// Shadow ray toward a light sample, it carries the contribution added to the pixel when nothing blocks it
+	struct CompactShadowRay
+	{
+		Point3<float> origin;
+		Vector2<float> direction;
+		float tmax;
+		uint32_t contribution;
+		uint32_t pixelID;
+
+		CompactShadowRay()
+			: origin(0), direction(0), tmax(0), contribution(0), pixelID(0)
+		{};
+
+		CompactShadowRay(const Point3f &origin, const Vec3f &dir, float tmax, const Spectrum &contribution, uint32_t pixel)
+			: origin(origin)
+			, direction(octEncode(dir))
+			, tmax(tmax)
+			, contribution(toRgb9e5(contribution))
+			, pixelID(pixel)
+		{}
+	};
 #pragma pack(pop)
 }
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "Denoise.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	constexpr Float kernel[3] = { (Float)3 / 8, (Float)1 / 4, (Float)1 / 16 };
+}
+
+bool atlas::task::Denoise::preExecute()
+{
+	tileCountX = (data.resolution.x + tileSize - 1) / tileSize;
+	tileCount = tileCountX * ((data.resolution.y + tileSize - 1) / tileSize);
+	return (tileCount > 0);
+}
+
+void atlas::task::Denoise::execute()
+{
+	const int32_t step = (int32_t)data.step;
+	while (true)
+	{
+		const uint32_t tile = tileIdx.fetch_add(1);
+		if (tile >= tileCount)
+			break;
+
+		const int32_t x0 = (tile % tileCountX) * tileSize;
+		const int32_t y0 = (tile / tileCountX) * tileSize;
+		const int32_t x1 = std::min(x0 + (int32_t)tileSize, data.resolution.x);
+		const int32_t y1 = std::min(y0 + (int32_t)tileSize, data.resolution.y);
+		for (int32_t y = y0; y < y1; y++)
+		{
+			for (int32_t x = x0; x < x1; x++)
+			{
+				const uint32_t center = x + y * data.resolution.x;
+				const Float lCenter = luminance(data.srcColors[center]);
+				const Float invSigma = 1 / (data.sigmaLuminance * std::sqrt(std::max(data.srcVariances[center], (Float)0)) + (Float)1e-4);
+				// Relative to the depth of the center and growing with the step, infinite depths only match each other
+				const Float depthScale = data.depths ? data.sigmaDepth * step * data.depths[center] + (Float)1e-4 : 0;
+
+				Spectrum color(0.f);
+				Float variance = 0;
+				Float weightSum = 0;
+				for (int32_t j = -2; j <= 2; j++)
+				{
+					const int32_t py = y + j * step;
+					if (py < 0 || py >= data.resolution.y)
+						continue;
+					for (int32_t i = -2; i <= 2; i++)
+					{
+						const int32_t px = x + i * step;
+						if (px < 0 || px >= data.resolution.x)
+							continue;
+
+						const uint32_t pixelID = px + py * data.resolution.x;
+						Float w = kernel[std::abs(i)] * kernel[std::abs(j)]
+							* std::exp(-std::abs(luminance(data.srcColors[pixelID]) - lCenter) * invSigma);
+						if (data.normals)
+							w *= std::pow(std::max(dot(data.normals[center], data.normals[pixelID]), (Float)0), data.normalPower);
+						if (data.depths && data.depths[pixelID] != data.depths[center])
+							w *= std::isinf(depthScale) ? 0 : std::exp(-std::abs(data.depths[pixelID] - data.depths[center]) / depthScale);
+						if (w == 0)
+							continue;
+						color += data.srcColors[pixelID] * w;
+						variance += data.srcVariances[pixelID] * w * w;
+						weightSum += w;
+					}
+				}
+
+				// The center always contributes, weightSum is never zero
+				data.dstColors[center] = color / weightSum;
+				data.dstVariances[center] = variance / (weightSum * weightSum);
+			}
+		}
+	}
+}
+
+void atlas::task::Denoise::postExecute()
+{}
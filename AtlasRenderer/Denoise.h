@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+
+#include "atlas/core/Points.h"
+#include "atlas/core/RgbSpectrum.h"
+
+#include "ThreadPool.h"
+
+namespace atlas
+{
+	namespace task
+	{
+		// One pass of an edge-aware a-trous wavelet filter, the 5x5 B3 spline kernel is spread over
+		// step pixels. Neighbours are weighted down by their luminance difference relative to the
+		// standard deviation of the center, which is filtered along with the color. The normals and
+		// depths of the first hits, when given, also stop the filter at geometric edges.
+		class Denoise : public ThreadedTask
+		{
+		public:
+			static constexpr uint32_t tileSize = 64;
+
+			struct Data
+			{
+				Point2i resolution;
+				uint32_t step = 1;
+				Float sigmaLuminance = 4;
+				Float sigmaDepth = (Float)0.05;
+				Float normalPower = 128;
+
+				const Spectrum *srcColors = nullptr;
+				const Float *srcVariances = nullptr;
+				Spectrum *dstColors = nullptr;
+				Float *dstVariances = nullptr;
+
+				const Normal *normals = nullptr;
+				const Float *depths = nullptr;
+			};
+
+			Denoise(Data &data)
+				: data(data)
+			{}
+
+			bool preExecute() override;
+			void execute() override;
+			void postExecute() override;
+
+		private:
+			Data data;
+
+			std::atomic<uint32_t> tileIdx = 0;
+			uint32_t tileCountX = 0;
+			uint32_t tileCount = 0;
+		};
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "atlas/core/Interaction.h"
+#include "atlas/core/Light.h"
+#include "atlas/core/StatelessSampler.h"
+
+#include "Material.h"
+
+namespace atlas
+{
+	inline void drawLightSample(uint32_t pixelID, uint32_t filmWidth, uint32_t sampleID, uint32_t depth, bool blueNoise, Float &uLight, Point2f &uSample)
+	{
+		if (blueNoise)
+		{
+			uLight = StatelessSampler::getBlueNoise1D(pixelID, filmWidth, sampleID, depth, StatelessSampler::LightDimension);
+			uSample = StatelessSampler::getBlueNoise2D(pixelID, filmWidth, sampleID, depth, StatelessSampler::LightSampleDimension);
+		}
+		else
+		{
+			uLight = StatelessSampler::get1D(pixelID, sampleID, depth, StatelessSampler::LightDimension);
+			uSample = StatelessSampler::get2D(pixelID, sampleID, depth, StatelessSampler::LightSampleDimension);
+		}
+	}
+
+	// Shadow ray toward a point of one of the lights picked uniformly, and the contribution it carries when
+	// nothing blocks it. Returns false when the sample cannot contribute.
+	inline bool sampleDirectLight(const std::vector<std::shared_ptr<Light>> &lights, const Material &material, const Vec3f &wo,
+		const SurfaceInteraction &si, const Spectrum &throughput, Float uLight, const Point2f &uSample, Float tmin,
+		Ray &shadowRay, Spectrum &contribution)
+	{
+		const uint32_t lightCount = (uint32_t)lights.size();
+		const Light &light = *lights[std::min((uint32_t)(uLight * lightCount), lightCount - 1)];
+		Vec3f wi;
+		Float lightPdf = 0;
+		VisibilityTester vis;
+		const Spectrum Le = light.sampleLi(si, uSample, wi, lightPdf, vis);
+		if (lightPdf == 0 || Le.isBlack())
+			return (false);
+
+		// Li is the weight of a sample drawn with the bsdf pdf, Li * scatteringPdf gives back f * cos
+		const BSDF f = material.evaluate(wo, wi, si);
+		contribution = throughput * f.Li * Le * (f.scatteringPdf * (Float)lightCount / lightPdf);
+		if (contribution.isBlack())
+			return (false);
+
+		const Float lightDistance = distance(si.p, vis.getP1().p);
+		shadowRay = Ray(si.p + tmin * wi, wi, lightDistance * (1 - (Float)1e-3) - tmin);
+		return (true);
+	}
+}
@@ -63,6 +63,8 @@ void atlas::task::ExtractBatch::execute()
 			data.dst->sampleIDs[i] = handle.buffer[i].sampleID;
 			data.dst->depths[i] = handle.buffer[i].depth;
 			data.dst->tNears[i] = handle.buffer[i].tNear;
+			data.dst->coneWidths[i] = fromHalf(handle.buffer[i].coneWidth);
+			data.dst->coneSpreads[i] = fromHalf(handle.buffer[i].coneSpread);
 		}
 	}
 }
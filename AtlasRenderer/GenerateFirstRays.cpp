@@ -4,7 +4,29 @@
 bool atlas::task::GenerateFirstRays::preExecute()
 {
 	zOrderMax = posToZOrderIndex(data.resolution.x, data.resolution.y);
-	data.batchManager->openBins();
+	if (data.zOrderEnd)
+		zOrderMax = std::min(zOrderMax, data.zOrderEnd);
+	zOrderPos = data.zOrderBegin;
+	if (zOrderPos >= zOrderMax)
+		return (false);
+
+	// The footprint of a pixel barely changes over the film, it is measured once at its center
+	CameraSample cs;
+	cs.pFilm = Point2f((Float)data.resolution.x / 2, (Float)data.resolution.y / 2);
+	cs.pLens = Point2f(0.5, 0.5);
+	cs.time = 0;
+	RayDifferential rd;
+	data.camera->generateRayDifferential(cs, &rd);
+	if (rd.hasDifferentials)
+	{
+		coneWidth = distance(rd.origin, rd.rxOrigin);
+		coneSpread = (normalize(rd.rxDirection) - rd.dir).length();
+	}
+
+	if (data.openBins)
+		data.batchManager->openBins();
+	else
+		data.batchManager->mapBins();
 	return (true);
 }
 
@@ -13,7 +35,6 @@ void atlas::task::GenerateFirstRays::execute()
 	thread_local std::array<LocalBin, 6> localBins =
 	{ LocalBin(data.localBinSize), LocalBin(data.localBinSize), LocalBin(data.localBinSize),
 	LocalBin(data.localBinSize), LocalBin(data.localBinSize), LocalBin(data.localBinSize) };
-	std::unique_ptr<Sampler> sampler(data.sampler->clone(1));
 
 	while (true)
 	{
@@ -21,27 +42,30 @@ void atlas::task::GenerateFirstRays::execute()
 		if (offset >= zOrderMax)
 			break;
 
-		for (uint64_t i = offset; i < offset + zOrderStep; i++)
+		const uint64_t end = std::min(offset + zOrderStep, zOrderMax);
+		for (uint64_t i = offset; i < end; i++)
 		{
 			uint32_t x;
 			uint32_t y;
 			zOrderIndexToPos(i, x, y);
 			if (x < (uint32_t)data.resolution.x && y < (uint32_t)data.resolution.y)
 			{
-				sampler->startPixel(Point2i(x, y), true);
-				for (uint32_t s = 0; s < data.spp; s++)
+				const uint32_t pixelID = x + y * data.resolution.x;
+				if (data.activePixels && !data.activePixels[pixelID])
+					continue;
+				for (uint32_t s = data.firstSample; s < data.firstSample + data.spp; s++)
 				{
 					atlas::Ray r;
-					atlas::CameraSample cs = sampler->getCameraSample(Point2i(x, y));
+					atlas::CameraSample cs = data.blueNoise
+						? StatelessSampler::getBlueNoiseCameraSample(Point2i(x, y), s)
+						: StatelessSampler::getCameraSample(Point2i(x, y), pixelID, s);
 					data.camera->generateRay(cs, r);
 
 					const uint8_t vectorIndex = abs(r.dir).maxDimension();
 					const bool isNegative = std::signbit(r.dir[vectorIndex]);
 					const uint8_t index = vectorIndex * 2 + isNegative;
-					if (localBins[index].feed(CompactRay(r, x + y * data.resolution.x, s, 0)))
+					if (localBins[index].feed(CompactRay(r, pixelID, s, 0, coneWidth, coneSpread)))
 						data.batchManager->feed(index, localBins[index]);
-
-					sampler->startNextSample();
 				}
 			}
 		}
@@ -6,6 +6,8 @@
 #include "ThreadPool.h"
 #include "LocalBin.h"
 
+#include "atlas/core/StatelessSampler.h"
+
 namespace atlas
 {
 	namespace task
@@ -19,11 +21,21 @@ namespace atlas
 			{
 				Point2i resolution;
 				uint32_t spp = 0;
+				// Index of the first sample of the iteration, so that every iteration draws new samples
+				uint32_t firstSample = 0;
+				bool blueNoise = false;
+				// Pixels without enough error are skipped, null when every pixel gets samples
+				const uint8_t *activePixels = nullptr;
 
 				uint32_t localBinSize = 512;
 
+				// Range of z-order indices to generate, the whole film when zOrderEnd is 0.
+				// The bins are opened by the first range of an iteration and only mapped by the next ones.
+				uint64_t zOrderBegin = 0;
+				uint64_t zOrderEnd = 0;
+				bool openBins = true;
+
 				const Camera *camera = nullptr;
-				Sampler *sampler = nullptr;
 				BatchManager *batchManager = nullptr;
 			};
 
@@ -40,6 +52,9 @@ namespace atlas
 
 			std::atomic<uint64_t> zOrderPos = 0;
 			uint64_t zOrderMax = 0;
+
+			Float coneWidth = 0;
+			Float coneSpread = 0;
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+#include "atlas/core/RgbSpectrum.h"
+
+namespace atlas
+{
+	struct Sample
+	{
+		uint32_t pixelID;
+		Spectrum color;
+	};
+
+	// Samples of a batch grouped by shading thread and by range of pixels. Each thread fills its
+	// own slot without locking, a range of pixels is then added to the film by a single thread
+	// that reads it from every slot.
+	class SampleBuckets
+	{
+	public:
+		static constexpr uint32_t BucketShift = 12;
+
+		// Every thread running a task takes a slot, the workers of the pool and the one joining it
+		SampleBuckets(uint32_t slotCapacity)
+			: slots(slotCapacity)
+		{}
+
+		void reset(uint32_t pixelCount)
+		{
+			bucketCount = (pixelCount >> BucketShift) + 1;
+			slotCount = 0;
+		}
+
+		// Called once by each thread of the task filling the buckets
+		std::vector<std::vector<Sample>> &acquireSlot()
+		{
+			const uint32_t slot = slotCount.fetch_add(1);
+			// Not only an assert, past the capacity the thread would write out of the slots
+			if (slot >= slots.size())
+				std::abort();
+			std::vector<std::vector<Sample>> &buckets = slots[slot];
+			buckets.resize(bucketCount);
+			for (std::vector<Sample> &bucket : buckets)
+				bucket.clear();
+			return (buckets);
+		}
+
+		static inline uint32_t getBucket(uint32_t pixelID)
+		{
+			return (pixelID >> BucketShift);
+		}
+
+		uint32_t getBucketCount() const
+		{
+			return (bucketCount);
+		}
+
+		uint32_t getSlotCount() const
+		{
+			return (slotCount);
+		}
+
+		const std::vector<Sample> &getSamples(uint32_t slot, uint32_t bucket) const
+		{
+			return (slots[slot][bucket]);
+		}
+
+	private:
+		uint32_t bucketCount = 0;
+		std::atomic<uint32_t> slotCount = 0;
+		std::vector<std::vector<std::vector<Sample>>> slots;
+	};
+}
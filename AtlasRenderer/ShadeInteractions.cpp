@@ -18,9 +18,13 @@ void atlas::task::ShadeInteractions::execute()
 	thread_local std::array<LocalBin, 6> localBins =
 	{ LocalBin(data.localBinSize), LocalBin(data.localBinSize), LocalBin(data.localBinSize),
 	LocalBin(data.localBinSize), LocalBin(data.localBinSize), LocalBin(data.localBinSize) };
-	std::unique_ptr<Sampler> sampler = data.sampler->clone(1);
-
-	std::vector<Sample> samples;
+	// Scratch memory kept between batches so that shading does not allocate once warmed up
+	thread_local DataBlock shadingBlock;
+	thread_local Block<Vec3f> wo;
+	thread_local Block<Point2f> randomPoints;
+	thread_local Block<BSDFSample> bsdfs;
+	std::vector<std::vector<Sample>> &samples = data.buckets->acquireSlot();
+	std::vector<CompactShadowRay> *shadowRays = data.lights ? &data.shadowRays->acquireSlot() : nullptr;
 
 	while (true)
 	{
@@ -28,20 +32,69 @@ void atlas::task::ShadeInteractions::execute()
 		if (idx >= data.shadingPack->size())
 			break;
 
-#if 1
-		for (uint32_t i = data.shadingPack->at(idx).start; i <= data.shadingPack->at(idx).end; i++)
+		const ShadingPack &pack = data.shadingPack->at(idx);
+		const uint32_t count = pack.end - pack.start + 1;
+		shadingBlock.reserve(pack.material->getDataSize() * count);
+		wo.reserve(count);
+		randomPoints.reserve(count);
+		bsdfs.reserve(count);
+
+		if (!data.blueNoise)
+			StatelessSampler::get2D(&data.batch->pixelIDs[pack.start], &data.batch->sampleIDs[pack.start], &data.batch->depths[pack.start],
+				StatelessSampler::BsdfDimension, count, &randomPoints[0]);
+		for (uint32_t i = 0; i < count; i++)
 		{
-			data.sampler->startPixel(Point2i(0, 0));
+			const uint32_t j = pack.start + i;
+			wo[i] = -data.batch->directions[j];
+			if (data.blueNoise)
+				randomPoints[i] = StatelessSampler::getBlueNoise2D(data.batch->pixelIDs[j], data.filmWidth, data.batch->sampleIDs[j], data.batch->depths[j], StatelessSampler::BsdfDimension);
+			data.interactions->at(j).computeDifferentials(Ray(data.batch->origins[j], data.batch->directions[j]),
+				data.batch->coneWidths[j], data.batch->coneSpreads[j]);
+		}
+
+		{
+			Block<Vec3f> packWo(wo, 0, count);
+			Block<SurfaceInteraction> packInteractions(*data.interactions, pack.start, count);
+			Block<Point2f> packPoints(randomPoints, 0, count);
+			Block<BSDFSample> packBsdfs(bsdfs, 0, count);
+			pack.material->sample(packWo, packInteractions, packPoints, packBsdfs, shadingBlock);
+		}
 
-			BSDFSample bsdf = data.shadingPack->at(idx).material->sample(-data.batch->directions[i], data.interactions->at(i), sampler->get2D());
+		for (uint32_t j = 0; j < count; j++)
+		{
+			const uint32_t i = pack.start + j;
+			const BSDFSample &bsdf = bsdfs[j];
 			Spectrum color = data.batch->colors[i] * bsdf.Li;
-			
-			if (!bsdf.Le.isBlack())
+
+			// A pixel has a single sample 0, it is the only one writing its AOVs.
+			// The weight of the bsdf sample stands for the albedo, it is exact for diffuse surfaces.
+			if (data.aovs && data.batch->depths[i] == 0 && data.batch->sampleIDs[i] == 0)
+			{
+				const SurfaceInteraction &si = data.interactions->at(i);
+				data.aovs->setAovs(data.batch->pixelIDs[i], bsdf.Li, si.shading.n,
+					distance(data.batch->origins[i], si.p), pack.material->getID());
+			}
+
+			const bool lightHit = data.lights && data.batch->depths[i] > 0 && data.interactions->at(i).primitive
+				&& data.interactions->at(i).primitive->getAreaLight();
+			if (!bsdf.Le.isBlack() && !lightHit)
 			{
 				Sample s;
 				s.color = data.batch->colors[i] * bsdf.Le;
 				s.pixelID = data.batch->pixelIDs[i];
-				samples.push_back(s);
+				samples[SampleBuckets::getBucket(s.pixelID)].push_back(s);
+			}
+
+			if (data.lights && !data.lights->empty() && !bsdf.Li.isBlack())
+			{
+				Float uLight;
+				Point2f uSample;
+				drawLightSample(data.batch->pixelIDs[i], data.filmWidth, data.batch->sampleIDs[i], data.batch->depths[i], data.blueNoise, uLight, uSample);
+				Ray shadowRay;
+				Spectrum contribution;
+				if (sampleDirectLight(*data.lights, *pack.material, wo[j], data.interactions->at(i), data.batch->colors[i],
+					uLight, uSample, data.tmin, shadowRay, contribution))
+					shadowRays->emplace_back(shadowRay.origin, shadowRay.dir, (float)shadowRay.tmax, contribution, data.batch->pixelIDs[i]);
 			}
 
 			if (luminance(color) < data.lightTreshold || bsdf.wi.length() == 0)
@@ -49,81 +102,28 @@ void atlas::task::ShadeInteractions::execute()
 				Sample s;
 				s.color = color;
 				s.pixelID = data.batch->pixelIDs[i];
-				samples.push_back(s);
-				//printf("luminance too low\n");
+				samples[SampleBuckets::getBucket(s.pixelID)].push_back(s);
 				continue;
 			}
 
 			if (data.batch->depths[i] < data.maxDepth)
 			{
-				Ray r(data.interactions->at(i).p + data.tmin * bsdf.wi, bsdf.wi);
+				const SurfaceInteraction &si = data.interactions->at(i);
+				Ray r(si.p + data.tmin * bsdf.wi, bsdf.wi);
 				const uint8_t vectorIndex = abs(bsdf.wi).maxDimension();
 				const bool isNegative = std::signbit(bsdf.wi[vectorIndex]);
 				const uint8_t index = vectorIndex * 2 + isNegative;
-				if (localBins[index].feed(CompactRay(r, color, data.batch->pixelIDs[i], data.batch->sampleIDs[i], data.batch->depths[i] + 1)))
-					data.batchManager->feed(index, localBins[index]);
-			}
-			else
-			{
-				//printf("max depth\n");
-			}
-		}
-#else
-		Block<sh::BSDF> bsdfs(data.shadingPack->at(idx).end - data.shadingPack->at(idx).start + 1);
-		Block<Point2f> randomPoints(data.shadingPack->at(idx).end - data.shadingPack->at(idx).start + 1);
-		for (uint32_t i = 0; i < randomPoints.size(); i++)
-		{
-			data.sampler->startPixel(Point2i(0, 0));
-			randomPoints[i] = sampler->get2D();
-		}
-
-		{
-			Block negWo(data.batch->directions, data.shadingPack->at(idx).start, bsdfs.size());
-			Block its(*data.interactions, data.shadingPack->at(idx).start, bsdfs.size());
-			data.shadingPack->at(idx).material->sample(
-				negWo,
-				its,
-				randomPoints, bsdfs);
-		}
-
-		for (uint32_t i = 0; i < bsdfs.size(); i++)
-		{
-			if (!bsdfs[i].Le.isBlack())
-			{
-				Sample s;
-				s.color = data.batch->colors[i] * bsdfs[i].Le;
-				s.pixelID = data.batch->pixelIDs[i];
-				samples.push_back(s);
-			}
-
-			if (data.batch->depths[data.shadingPack->at(idx).start + i] < data.maxDepth
-				&& !(data.batch->colors[data.shadingPack->at(idx).start + i] * bsdfs[i].Li).isBlack()
-				&& bsdfs[i].wi.length() != 0)
-			{
-				Ray r(data.interactions->at(data.shadingPack->at(idx).start + i).p, bsdfs[i].wi);
-
-				const uint8_t vectorIndex = abs(bsdfs[i].wi).maxDimension();
-				const bool isNegative = std::signbit(bsdfs[i].wi[vectorIndex]);
-				const uint8_t index = vectorIndex * 2 + isNegative;
-				if (localBins[index].feed(CompactRay(r, data.batch->colors[data.shadingPack->at(idx).start + i]
-					* bsdfs[i].Li, data.batch->pixelIDs[data.shadingPack->at(idx).start + i],
-					data.batch->sampleIDs[data.shadingPack->at(idx).start + i],
-					data.batch->depths[data.shadingPack->at(idx).start + i] + 1)))
+				// The cone keeps its spread across bounces, its width grows with the distance travelled
+				const Float width = data.batch->coneWidths[i] + data.batch->coneSpreads[i] * distance(data.batch->origins[i], si.p);
+				if (localBins[index].feed(CompactRay(r, color, data.batch->pixelIDs[i], data.batch->sampleIDs[i], data.batch->depths[i] + 1, 0, width, data.batch->coneSpreads[i])))
 					data.batchManager->feed(index, localBins[index]);
 			}
 		}
-#endif
 	}
 
+	for (uint32_t i = 0; i < localBins.size(); i++)
 	{
-		for (uint32_t i = 0; i < localBins.size(); i++)
-		{
-			data.batchManager->feed(i, localBins[i]);
-		}
-
-		data.samplesGuard->lock();
-		data.samples->insert(data.samples->end(), samples.begin(), samples.end());
-		data.samplesGuard->unlock();
+		data.batchManager->feed(i, localBins[i]);
 	}
 }
 
@@ -8,8 +8,13 @@
 #include "ThreadPool.h"
 
 #include "BSDF.h"
+#include "DirectLighting.h"
 #include "Material.h"
 #include "LocalBin.h"
+#include "SampleBuckets.h"
+#include "ShadowRayQueue.h"
+
+#include "atlas/core/StatelessSampler.h"
 
 namespace atlas
 {
@@ -20,12 +25,6 @@ namespace atlas
 		Material *material;
 	};
 
-	struct Sample
-	{
-		uint32_t pixelID;
-		Spectrum color;
-	};
-
 	namespace task
 	{
 		class ShadeInteractions : public ThreadedTask
@@ -40,16 +39,23 @@ namespace atlas
 
 				Float tmin = 0;
 				Float lightTreshold = (Float)0.01;
+				bool blueNoise = false;
+				uint32_t filmWidth = 0;
+
+				SampleBuckets *buckets = nullptr;
+				// Receives the first hit of the first sample of each pixel, null when the film has no AOV
+				Film *aovs = nullptr;
 
-				std::vector<Sample> *samples = nullptr;
-				std::mutex *samplesGuard = nullptr;
+				// One light sampled per interaction when not null, its shadow ray goes to the queue.
+				// Emission found by the bsdf rays after the first hit is then left to the light samples.
+				const std::vector<std::shared_ptr<Light>> *lights = nullptr;
+				ShadowRayQueue *shadowRays = nullptr;
 
 				Batch *batch = nullptr;
 				Block<SurfaceInteraction> *interactions;
 
 				std::vector<ShadingPack> *shadingPack;
 
-				Sampler *sampler = nullptr;
 				BatchManager *batchManager = nullptr;
 			};
 
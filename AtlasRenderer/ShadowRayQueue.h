@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+#include "CompactRay.h"
+
+namespace atlas
+{
+	// Shadow rays emitted while shading a batch, each shading thread fills its own slot without locking.
+	// They are traced once the whole batch is shaded.
+	class ShadowRayQueue
+	{
+	public:
+		// One slot per thread of the pool, like SampleBuckets
+		ShadowRayQueue(uint32_t slotCapacity)
+			: slots(slotCapacity)
+		{}
+
+		void reset()
+		{
+			slotCount = 0;
+		}
+
+		// Called once by each thread of the task filling the queue
+		std::vector<CompactShadowRay> &acquireSlot()
+		{
+			const uint32_t slot = slotCount.fetch_add(1);
+			if (slot >= slots.size())
+				std::abort();
+			slots[slot].clear();
+			return (slots[slot]);
+		}
+
+		uint32_t getSlotCount() const
+		{
+			return (slotCount);
+		}
+
+		const std::vector<CompactShadowRay> &getRays(uint32_t slot) const
+		{
+			return (slots[slot]);
+		}
+
+	private:
+		std::atomic<uint32_t> slotCount = 0;
+		std::vector<std::vector<CompactShadowRay>> slots;
+	};
+}
@@ -0,0 +1,43 @@
+#include "TraceShadowRays.h"
+
+bool atlas::task::TraceShadowRays::preExecute()
+{
+	chunks.clear();
+	for (uint32_t slot = 0; slot < data.queue->getSlotCount(); slot++)
+	{
+		const uint32_t count = (uint32_t)data.queue->getRays(slot).size();
+		for (uint32_t first = 0; first < count; first += chunkSize)
+			chunks.emplace_back(slot, first);
+	}
+	return (!chunks.empty());
+}
+
+void atlas::task::TraceShadowRays::execute()
+{
+	std::vector<std::vector<Sample>> &samples = data.buckets->acquireSlot();
+
+	while (true)
+	{
+		const uint32_t idx = chunkIdx.fetch_add(1);
+		if (idx >= chunks.size())
+			break;
+
+		const std::vector<CompactShadowRay> &rays = data.queue->getRays(chunks[idx].first);
+		const uint32_t end = std::min(chunks[idx].second + chunkSize, (uint32_t)rays.size());
+		for (uint32_t i = chunks[idx].second; i < end; i++)
+		{
+			const CompactShadowRay &shadowRay = rays[i];
+			Ray r(Point3f(shadowRay.origin), octDecode(shadowRay.direction), shadowRay.tmax);
+			if (data.scene->intersectP(r))
+				continue;
+
+			Sample s;
+			s.pixelID = shadowRay.pixelID;
+			s.color = toColor(shadowRay.contribution);
+			samples[SampleBuckets::getBucket(s.pixelID)].push_back(s);
+		}
+	}
+}
+
+void atlas::task::TraceShadowRays::postExecute()
+{}
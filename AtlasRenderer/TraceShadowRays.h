@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "Atlas/core/Primitive.h"
+
+#include "SampleBuckets.h"
+#include "ShadowRayQueue.h"
+#include "ThreadPool.h"
+
+namespace atlas
+{
+	namespace task
+	{
+		// Any-hit test of the shadow rays of a batch, the contribution of the unoccluded ones goes to the sample buckets
+		class TraceShadowRays : public ThreadedTask
+		{
+		public:
+			static constexpr uint32_t chunkSize = 1024;
+
+			struct Data
+			{
+				const ShadowRayQueue *queue = nullptr;
+				const Primitive *scene = nullptr;
+				SampleBuckets *buckets = nullptr;
+			};
+
+			TraceShadowRays(Data &data)
+				: data(data)
+			{}
+
+			bool preExecute() override;
+			void execute() override;
+			void postExecute() override;
+
+		private:
+			Data data;
+
+			// Slot and first ray of each chunk
+			std::vector<std::pair<uint32_t, uint32_t>> chunks;
+			std::atomic<uint32_t> chunkIdx = 0;
+		};
+	}
+}
@@ -0,0 +1,92 @@
+#include "TraceSmallBatch.h"
+
+#include "atlas/core/StatelessSampler.h"
+
+#include "DirectLighting.h"
+#include "Material.h"
+
+bool atlas::task::TraceSmallBatch::preExecute()
+{
+	return (data.batch->size() > 0);
+}
+
+void atlas::task::TraceSmallBatch::execute()
+{
+	std::vector<std::vector<Sample>> &samples = data.buckets->acquireSlot();
+	const bool sampleLights = data.lights && !data.lights->empty();
+
+	while (true)
+	{
+		const uint32_t first = rayIdx.fetch_add(chunkSize);
+		if (first >= data.batch->size())
+			break;
+
+		const uint32_t end = std::min(first + chunkSize, data.batch->size());
+		for (uint32_t i = first; i < end; i++)
+		{
+			const uint32_t pixelID = data.batch->pixelIDs[i];
+			const uint32_t sampleID = data.batch->sampleIDs[i];
+			uint32_t depth = data.batch->depths[i];
+			Spectrum throughput = data.batch->colors[i];
+			Float coneWidth = data.batch->coneWidths[i];
+			const Float coneSpread = data.batch->coneSpreads[i];
+			Ray r(data.batch->origins[i], data.batch->directions[i]);
+
+			while (true)
+			{
+				SurfaceInteraction si;
+				if (!data.scene->intersect(r, si) || !si.material)
+				{
+					const Float t = (Float)0.5 * (r.dir.y + (Float)1.0);
+					const Spectrum sky(((Float)1.0 - t) * Spectrum(1.f) + t * Spectrum((Float)0.5, (Float)0.7, (Float)1.0));
+					samples[SampleBuckets::getBucket(pixelID)].push_back({ pixelID, throughput * sky });
+					if (data.aovs && depth == 0 && sampleID == 0)
+						data.aovs->setAovs(pixelID, sky, -r.dir, INFINITY, 0);
+					break;
+				}
+
+				si.computeDifferentials(r, coneWidth, coneSpread);
+				const Point2f u = data.blueNoise
+					? StatelessSampler::getBlueNoise2D(pixelID, data.filmWidth, sampleID, depth, StatelessSampler::BsdfDimension)
+					: StatelessSampler::get2D(pixelID, sampleID, depth, StatelessSampler::BsdfDimension);
+				const BSDFSample bsdf = si.material->sample(-r.dir, si, u);
+				const Spectrum color = throughput * bsdf.Li;
+
+				if (data.aovs && depth == 0 && sampleID == 0)
+					data.aovs->setAovs(pixelID, bsdf.Li, si.shading.n, distance(r.origin, si.p), si.material->getID());
+
+				const bool lightHit = data.lights && depth > 0 && si.primitive && si.primitive->getAreaLight();
+				if (!bsdf.Le.isBlack() && !lightHit)
+					samples[SampleBuckets::getBucket(pixelID)].push_back({ pixelID, throughput * bsdf.Le });
+
+				if (sampleLights && !bsdf.Li.isBlack())
+				{
+					Float uLight;
+					Point2f uSample;
+					drawLightSample(pixelID, data.filmWidth, sampleID, depth, data.blueNoise, uLight, uSample);
+					Ray shadowRay;
+					Spectrum contribution;
+					if (sampleDirectLight(*data.lights, *si.material, -r.dir, si, throughput, uLight, uSample, data.tmin, shadowRay, contribution)
+						&& !data.scene->intersectP(shadowRay))
+						samples[SampleBuckets::getBucket(pixelID)].push_back({ pixelID, contribution });
+				}
+
+				if (luminance(color) < data.lightTreshold || bsdf.wi.length() == 0)
+				{
+					samples[SampleBuckets::getBucket(pixelID)].push_back({ pixelID, color });
+					break;
+				}
+				if (depth >= data.maxDepth)
+					break;
+
+				coneWidth += coneSpread * distance(r.origin, si.p);
+				r = Ray(si.p + data.tmin * bsdf.wi, bsdf.wi);
+				throughput = color;
+				depth++;
+			}
+		}
+	}
+}
+
+void atlas::task::TraceSmallBatch::postExecute()
+{}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "Atlas/core/Film.h"
+#include "Atlas/core/Light.h"
+#include "Atlas/core/Primitive.h"
+#include "atlas/core/Batch.h"
+
+#include "SampleBuckets.h"
+#include "ThreadPool.h"
+
+namespace atlas
+{
+	namespace task
+	{
+		// Follows the paths of a batch too small for a wavefront pass to their end, each thread takes a
+		// few of them at a time. Shading, light sampling and termination are the same as ShadeInteractions.
+		class TraceSmallBatch : public ThreadedTask
+		{
+		public:
+			static constexpr uint32_t chunkSize = 16;
+
+			struct Data
+			{
+				uint32_t maxDepth = 16;
+				Float tmin = 0;
+				Float lightTreshold = (Float)0.01;
+				bool blueNoise = false;
+				uint32_t filmWidth = 0;
+
+				const Batch *batch = nullptr;
+				const Primitive *scene = nullptr;
+				const std::vector<std::shared_ptr<Light>> *lights = nullptr;
+				Film *aovs = nullptr;
+				SampleBuckets *buckets = nullptr;
+			};
+
+			TraceSmallBatch(Data &data)
+				: data(data)
+			{}
+
+			bool preExecute() override;
+			void execute() override;
+			void postExecute() override;
+
+		private:
+			Data data;
+
+			std::atomic<uint32_t> rayIdx = 0;
+		};
+	}
+}
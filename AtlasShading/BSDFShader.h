@@ -23,6 +23,11 @@ namespace atlas
 
 		}
 
+		void evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, DataBlock &block) const override
+		{
+
+		}
+
 		BSDF evaluate(const Vec3f &wo, const Vec3f &wi, const SurfaceInteraction &si, DataBlock &block) const
 		{
 			BSDF bsdf;
@@ -38,6 +43,15 @@ namespace atlas
 			return (bsdf);
 		}
 
+		virtual void evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, const Block<Point2f> &samples, DataBlock &block, Block<BSDFSample> &bsdfs) const
+		{
+			for (uint32_t i = 0; i < wo.size(); i++)
+			{
+				block.setLane(i);
+				bsdfs[i] = evaluate(wo[i], si[i], samples[i], block);
+			}
+		}
+
 		virtual void evaluateWi(const Vec3f &wo, const SurfaceInteraction &si, const Point2f &sample, const DataBlock &block, Vec3f &wi) const
 		{
 			Onb uvw(si.n);
@@ -16,6 +16,12 @@ namespace atlas
 		ATLAS_SH Spectrum diffuseModel(const DataBlock &block, const Float nDotL, const Float nDotV, const Float lDotH) const;
 		ATLAS_SH Spectrum specularModel(const DataBlock &block, const Vec3f &wo, const Vec3f &wi, const Vec3f &tangent, const Vec3f &binormal, const Vec3f &h, const Float nDotL, const Float nDotV, const Float nDotH, const Float lDotH) const;
 
+		void registerInputs(std::vector<ShadingInputBase *> &inputs) override
+		{
+			inputs.insert(inputs.end(), { &iBaseColor, &iSubsurface, &iMetallic, &iSpecular, &iSpecularTint,
+				&iRoughness, &iAnisotropic, &iSheen, &iSheenTint, &iClearcoat, &iClearcoatGloss });
+		}
+
 		Float scatteringPdf(const Interaction &intr, const Vec3f &wo, const Vec3f &wi) const override
 		{
 			return (1);
@@ -10,6 +10,12 @@ namespace atlas
 {
 	struct Emission : public BSDFShader
 	{
+		void registerInputs(std::vector<ShadingInputBase *> &inputs) override
+		{
+			inputs.push_back(&iColor);
+			inputs.push_back(&iStrength);
+		}
+
 		void evaluateBsdf(const Vec3f &wo, const Vec3f &wi, const SurfaceInteraction &si, const DataBlock &block, BSDF &bsdf) const override
 		{
 			bsdf.Le = iColor.get(block) * iStrength.get(block);
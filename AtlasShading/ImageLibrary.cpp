@@ -1,65 +1,548 @@
 #include "ImageLibrary.h"
 
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
 atlas::ImageLibrary atlas::ImageLibrary::instance;
 
-bool atlas::ImageWrapper::load()
+namespace
+{
+	// Box filters the texels [dstX0, dstX1) x [dstY0, dstY1) of a level from the finer one, of size srcWidth x srcHeight.
+	// src holds the texels of the finer level from (2 * dstX0, 2 * dstY0) on, a row every srcStride texels.
+	void downsample(const uint8_t *src, int32_t srcStride, int32_t srcWidth, int32_t srcHeight, uint8_t *dst, int32_t dstX0, int32_t dstY0, int32_t dstX1, int32_t dstY1)
+	{
+		const int32_t dstWidth = dstX1 - dstX0;
+		for (int32_t y = dstY0; y < dstY1; y++)
+		{
+			const int32_t y0 = std::min(2 * y, srcHeight - 1) - 2 * dstY0;
+			const int32_t y1 = std::min(2 * y + 1, srcHeight - 1) - 2 * dstY0;
+			for (int32_t x = dstX0; x < dstX1; x++)
+			{
+				const int32_t x0 = std::min(2 * x, srcWidth - 1) - 2 * dstX0;
+				const int32_t x1 = std::min(2 * x + 1, srcWidth - 1) - 2 * dstX0;
+				for (int32_t c = 0; c < 4; c++)
+				{
+					uint32_t sum = src[(x0 + y0 * srcStride) * 4 + c] + src[(x1 + y0 * srcStride) * 4 + c]
+						+ src[(x0 + y1 * srcStride) * 4 + c] + src[(x1 + y1 * srcStride) * 4 + c];
+					dst[((x - dstX0) + (y - dstY0) * dstWidth) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	// Hits of a thread not yet added to the counter of the image
+	struct PendingHits
+	{
+		atlas::ImageWrapper *image = nullptr;
+		uint64_t count = 0;
+	};
+
+	std::mutex pendingHitsGuard;
+	std::vector<std::unique_ptr<PendingHits>> pendingHits;
+
+	PendingHits *registerPendingHits()
+	{
+		std::lock_guard<std::mutex> lock(pendingHitsGuard);
+		pendingHits.push_back(std::make_unique<PendingHits>());
+		return (pendingHits.back().get());
+	}
+}
+
+atlas::ImageWrapper::~ImageWrapper()
+{
+	for (uint32_t i = 0; i < tileCount; i++)
+		delete[] tiles[i].texels.load(std::memory_order_relaxed);
+	if (uint8_t *texels = source.load(std::memory_order_relaxed))
+		stbi_image_free(texels);
+}
+
+size_t atlas::ImageWrapper::open(const uint32_t callValue)
+{
+	size_t loadedBytes = 0;
+	std::call_once(openFlag, [&]()
+		{
+			const size_t extension = filename.rfind('.');
+			if (extension != std::string::npos && filename.compare(extension, std::string::npos, ".atx") == 0)
+				loadedBytes = openTextureFile(callValue);
+			else
+				loadedBytes = load(callValue);
+		});
+	return (loadedBytes);
+}
+
+size_t atlas::ImageWrapper::load(const uint32_t callValue)
 {
+	int32_t width;
+	int32_t height;
 	int nbComp;
-	buffer = stbi_load(filename.c_str(), &width, &height, &nbComp, 4);
-	if (buffer)
+	// Only the header is read, the texels are decoded when the first tile is needed
+	if (!stbi_info(filename.c_str(), &width, &height, &nbComp))
+		return (0);
+
+	bHasAlpha = nbComp == 4;
+	sourceBytes = size_t(width) * height * 4;
+
+	// The eviction walks the tiles of the loaded images only, they are published before bIsLoaded
+	std::vector<Level> newLevels;
+	uint32_t newTileCount = 0;
+	int32_t levelWidth = width;
+	int32_t levelHeight = height;
+	while (true)
+	{
+		Level level;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.tilesX = (levelWidth + TileSize - 1) / TileSize;
+		level.tilesY = (levelHeight + TileSize - 1) / TileSize;
+		level.firstTile = newTileCount;
+		newTileCount += level.tilesX * level.tilesY;
+		newLevels.push_back(level);
+
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+	levels = std::move(newLevels);
+	tiles = std::make_unique<Tile[]>(newTileCount);
+	tileCount = newTileCount;
+
+	// Nothing is resident until the tiles are sampled
+	bIsLoaded.store(true, std::memory_order_release);
+	return (0);
+}
+
+size_t atlas::ImageWrapper::decodeSource()
+{
+	int32_t width;
+	int32_t height;
+	int nbComp;
+	uint8_t *texels = stbi_load(filename.c_str(), &width, &height, &nbComp, 4);
+	if (!texels)
+		return (0);
+
+	// The file may have changed since its header was read
+	if (width != levels[0].width || height != levels[0].height)
+	{
+		stbi_image_free(texels);
+		return (0);
+	}
+
+	loads.fetch_add(1, std::memory_order_relaxed);
+	source.store(texels, std::memory_order_relaxed);
+	residentBytes.fetch_add(sourceBytes, std::memory_order_relaxed);
+	return (sourceBytes);
+}
+
+size_t atlas::ImageWrapper::openTextureFile(const uint32_t callValue)
+{
+	file = std::make_unique<TextureFile>();
+	if (!file->open(filename) || file->getHeader().tileSize != TileSize)
+	{
+		file.reset();
+		return (0);
+	}
+
+	const TextureFileHeader &header = file->getHeader();
+	loads.fetch_add(1, std::memory_order_relaxed);
+	bHasAlpha = header.hasAlpha != 0;
+	encoding = header.encoding;
+	tileBytes = file->getTileBytes();
+	std::vector<Level> newLevels;
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		const TextureFileLevel &fileLevel = file->getLevel(i);
+		Level level;
+		level.width = fileLevel.width;
+		level.height = fileLevel.height;
+		level.tilesX = fileLevel.tilesX;
+		level.tilesY = fileLevel.tilesY;
+		level.firstTile = fileLevel.firstTile;
+		newLevels.push_back(level);
+	}
+	levels = std::move(newLevels);
+	tiles = std::make_unique<Tile[]>(header.tileCount);
+	tileCount = header.tileCount;
+
+	// Nothing is resident until the tiles are sampled
+	bIsLoaded.store(true, std::memory_order_release);
+	return (0);
+}
+
+size_t atlas::ImageWrapper::loadTile(const Level &level, const uint32_t tile, const uint32_t callValue)
+{
+	size_t loadedBytes = 0;
+	uint8_t *texels;
+	if (file)
+	{
+		texels = new uint8_t[tileBytes];
+		std::memcpy(texels, file->getTile(tile), tileBytes);
+	}
+	else
+	{
+		// The source is decoded again if it was evicted since the last miss
+		if (!source.load(std::memory_order_relaxed))
+		{
+			loadedBytes = decodeSource();
+			if (loadedBytes == 0)
+				return (0);
+		}
+		sourceCallValue.store(callValue, std::memory_order_relaxed);
+
+		// Only the texels under the tile are filtered down from the source, through every finer level
+		const int32_t tileX = (tile - level.firstTile) % level.tilesX;
+		const int32_t tileY = (tile - level.firstTile) / level.tilesX;
+		const int32_t x0 = tileX * TileSize;
+		const int32_t y0 = tileY * TileSize;
+		std::vector<uint8_t> storage;
+		int32_t stride;
+		const uint8_t *levelTexels = buildTexels(static_cast<uint32_t>(&level - levels.data()), x0, y0,
+			std::min(x0 + TileSize, level.width), std::min(y0 + TileSize, level.height), storage, stride);
+		texels = cutTile(level, tileX, tileY, levelTexels, stride);
+	}
+	tiles[tile].lastCallValue.store(callValue, std::memory_order_relaxed);
+	tiles[tile].texels.store(texels, std::memory_order_release);
+	residentBytes.fetch_add(tileBytes, std::memory_order_relaxed);
+	return (loadedBytes + tileBytes);
+}
+
+uint8_t *atlas::ImageWrapper::cutTile(const Level &level, int32_t tileX, int32_t tileY, const uint8_t *texels, int32_t stride) const
+{
+	// Tiles on the border are padded by repeating the last row and column
+	uint8_t *dst = new uint8_t[TileBytes];
+	for (int32_t y = 0; y < TileSize; y++)
+	{
+		const int32_t srcY = std::min(y, level.height - 1 - tileY * TileSize);
+		for (int32_t x = 0; x < TileSize; x++)
+		{
+			const int32_t srcX = std::min(x, level.width - 1 - tileX * TileSize);
+			std::memcpy(&dst[(x + y * TileSize) * 4], &texels[(srcX + srcY * stride) * 4], 4);
+		}
+	}
+	return (dst);
+}
+
+const uint8_t *atlas::ImageWrapper::buildTexels(uint32_t level, int32_t x0, int32_t y0, int32_t x1, int32_t y1, std::vector<uint8_t> &storage, int32_t &stride) const
+{
+	if (level == 0)
+	{
+		stride = levels[0].width;
+		return (&source.load(std::memory_order_relaxed)[(x0 + y0 * stride) * 4]);
+	}
+
+	const Level &finer = levels[level - 1];
+	std::vector<uint8_t> finerStorage;
+	int32_t finerStride;
+	const uint8_t *finerTexels = buildTexels(level - 1, 2 * x0, 2 * y0,
+		std::min(2 * x1, finer.width), std::min(2 * y1, finer.height), finerStorage, finerStride);
+
+	stride = x1 - x0;
+	storage.resize(stride * (y1 - y0) * 4);
+	downsample(finerTexels, finerStride, finer.width, finer.height, storage.data(), x0, y0, x1, y1);
+	return (storage.data());
+}
+
+size_t atlas::ImageWrapper::evictTiles(const uint32_t boundary, size_t &boundaryBytes, std::vector<uint8_t *> &retired)
+{
+	size_t releasedBytes = 0;
+	for (uint32_t i = 0; i < tileCount; i++)
+	{
+		Tile &tile = tiles[i];
+		if (!tile.texels.load(std::memory_order_relaxed))
+			continue;
+		const uint32_t age = tile.lastCallValue.load(std::memory_order_relaxed);
+		if (age > boundary || (age == boundary && boundaryBytes == 0))
+			continue;
+		if (age == boundary)
+			boundaryBytes -= std::min(boundaryBytes, tileBytes);
+
+		uint8_t *texels = tile.texels.exchange(nullptr, std::memory_order_acq_rel);
+		if (texels)
+		{
+			retired.push_back(texels);
+			releasedBytes += tileBytes;
+		}
+	}
+	evictedTiles.fetch_add(static_cast<uint32_t>(releasedBytes / tileBytes), std::memory_order_relaxed);
+
+	// The source is only read by the thread rebuilding a tile, it stays when one is doing it
+	const uint32_t sourceAge = sourceCallValue.load(std::memory_order_relaxed);
+	if (source.load(std::memory_order_relaxed) && (sourceAge < boundary || (sourceAge == boundary && boundaryBytes > 0)))
 	{
-		bIsLoaded = true;
-		bHasAlpha = nbComp == 4;
-		return (true);
+		std::unique_lock<std::mutex> lock(reloadGuard, std::try_to_lock);
+		if (lock.owns_lock())
+		{
+			if (sourceAge == boundary)
+				boundaryBytes -= std::min(boundaryBytes, sourceBytes);
+			stbi_image_free(source.exchange(nullptr, std::memory_order_relaxed));
+			releasedBytes += sourceBytes;
+		}
 	}
-	return (false);
+
+	residentBytes.fetch_sub(releasedBytes, std::memory_order_relaxed);
+	return (releasedBytes);
 }
 
-void atlas::ImageWrapper::unload()
+void atlas::ImageWrapper::getTileAges(std::vector<std::pair<uint32_t, size_t>> &ages) const
 {
-	if (buffer)
-		free(buffer);
-	bIsLoaded = false;
+	for (uint32_t i = 0; i < tileCount; i++)
+	{
+		if (tiles[i].texels.load(std::memory_order_relaxed))
+			ages.emplace_back(tiles[i].lastCallValue.load(std::memory_order_relaxed), tileBytes);
+	}
+	if (source.load(std::memory_order_relaxed))
+		ages.emplace_back(sourceCallValue.load(std::memory_order_relaxed), sourceBytes);
 }
 
-atlas::Spectrum atlas::ImageWrapper::sample(const Point2f &uv, const uint32_t callValue, Float &alpha)
+void atlas::ImageWrapper::flushPendingHits()
 {
-	uint32_t x = (uint32_t)(uv.x * width) % width;
-	uint32_t y = (uint32_t)(uv.y * height) % height;
-	uint8_t *rgba = &buffer[(x + y * width) * 4];
-	if (bHasAlpha)
-		alpha = rgba[3];
+	std::lock_guard<std::mutex> lock(pendingHitsGuard);
+	for (const std::unique_ptr<PendingHits> &pending : pendingHits)
+	{
+		if (pending->image)
+			pending->image->hits.fetch_add(pending->count, std::memory_order_relaxed);
+		pending->count = 0;
+	}
+}
+
+atlas::TextureStatistics atlas::ImageWrapper::getStatistics() const
+{
+	TextureStatistics statistics;
+	statistics.hits = hits.load(std::memory_order_relaxed);
+	statistics.misses = misses.load(std::memory_order_relaxed);
+	statistics.loads = loads.load(std::memory_order_relaxed);
+	statistics.evictedTiles = evictedTiles.load(std::memory_order_relaxed);
+	return (statistics);
+}
+
+const uint8_t *atlas::ImageWrapper::getTile(const Level &level, int32_t &x, int32_t &y, const uint32_t callValue, size_t &loadedBytes)
+{
+	x = ((x % level.width) + level.width) % level.width;
+	y = ((y % level.height) + level.height) % level.height;
+
+	const uint32_t tileIdx = level.firstTile + x / TileSize + (y / TileSize) * level.tilesX;
+	Tile &tile = tiles[tileIdx];
+	x %= TileSize;
+	y %= TileSize;
+	const uint8_t *texels = tile.texels.load(std::memory_order_acquire);
+	if (!texels)
+	{
+		misses.fetch_add(1, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(reloadGuard);
+			// Another thread may have rebuilt the tile while this one was waiting
+			if (!tile.texels.load(std::memory_order_acquire))
+				loadedBytes += loadTile(level, tileIdx, callValue);
+		}
+		texels = tile.texels.load(std::memory_order_acquire);
+		if (!texels)
+			return (nullptr);
+	}
 	else
+	{
+		// Hits are accumulated per thread so that workers do not fight over the counter,
+		// the remainder is added by flushPendingHits once the threads are done sampling
+		thread_local PendingHits *pending = registerPendingHits();
+		if (pending->image != this || pending->count == 1024)
+		{
+			if (pending->image)
+				pending->image->hits.fetch_add(pending->count, std::memory_order_relaxed);
+			pending->image = this;
+			pending->count = 0;
+		}
+		pending->count++;
+	}
+
+	if (tile.lastCallValue.load(std::memory_order_relaxed) != callValue)
+		tile.lastCallValue.store(callValue, std::memory_order_relaxed);
+	return (texels);
+}
+
+bool atlas::ImageWrapper::bilinear(const Level &level, const Point2f &uv, const uint32_t callValue, __m128 &rgba, size_t &loadedBytes)
+{
+	const Float x = uv.x * level.width - (Float)0.5;
+	const Float y = uv.y * level.height - (Float)0.5;
+	const int32_t x0 = (int32_t)std::floor(x);
+	const int32_t y0 = (int32_t)std::floor(y);
+	const float dx = (float)(x - x0);
+	const float dy = (float)(y - y0);
+
+	const float weights[4] = { (1 - dx) * (1 - dy), dx * (1 - dy), (1 - dx) * dy, dx * dy };
+
+	rgba = _mm_setzero_ps();
+	for (int32_t i = 0; i < 4; i++)
+	{
+		int32_t x = x0 + (i & 1);
+		int32_t y = y0 + (i >> 1);
+		const uint8_t *tile = getTile(level, x, y, callValue, loadedBytes);
+		if (!tile)
+			return (false);
+		rgba = _mm_add_ps(rgba, _mm_mul_ps(fetchTexel(encoding, tile, TileSize, x, y), _mm_set1_ps(weights[i])));
+	}
+	return (true);
+}
+
+atlas::Spectrum atlas::ImageWrapper::sample(const Point2f &uv, Float width, const uint32_t callValue, Float &alpha, size_t &loadedBytes)
+{
+	const Float maxLevel = (Float)(levels.size() - 1);
+	const Float texelWidth = width * std::max(levels[0].width, levels[0].height);
+	const Float lod = texelWidth > 1 ? std::min(std::log2(texelWidth), maxLevel) : 0;
+	const uint32_t level = (uint32_t)lod;
+	const float t = (float)(lod - level);
+
+	__m128 rgba;
+	bool valid = bilinear(levels[level], uv, callValue, rgba, loadedBytes);
+	if (valid && t > 0 && level + 1 < levels.size())
+	{
+		__m128 coarser;
+		valid = bilinear(levels[level + 1], uv, callValue, coarser, loadedBytes);
+		rgba = _mm_add_ps(rgba, _mm_mul_ps(_mm_sub_ps(coarser, rgba), _mm_set1_ps(t)));
+	}
+	if (!valid)
+	{
 		alpha = 1;
-	lastCallValue = callValue;
-	return (Spectrum((Float)rgba[0] / 255, (Float)rgba[1] / 255, (Float)rgba[2] / 255));
+		return (Spectrum(1, 0, 0));
+	}
+
+	alignas(16) float values[4];
+	_mm_store_ps(values, _mm_mul_ps(rgba, _mm_set1_ps(1.f / 255)));
+	alpha = bHasAlpha ? values[3] : 1;
+	return (Spectrum(values[0], values[1], values[2]));
 }
 
 atlas::ImageID atlas::ImageLibrary::privateRequestID(const std::string &filename)
 {
-	for (uint32_t i = 0; i < images.size(); i++)
+	std::lock_guard<std::mutex> lock(requestGuard);
+	const uint32_t count = imageCount.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < count; i++)
 	{
-		if (images[i].getFilename() == filename)
+		if (images[i]->getFilename() == filename)
 		{
 			return (i);
 		}
 	}
-	images.emplace_back(filename);
-	return (images.size() - 1);
+	if (count >= MaxImages)
+	{
+		std::cout << "ImageLibrary: more than " << MaxImages << " images requested, " << filename << " is ignored" << std::endl;
+		return (InvalidID);
+	}
+	images[count] = std::make_unique<ImageWrapper>(filename);
+	imageCount.store(count + 1, std::memory_order_release);
+	return (count);
 }
 
-atlas::Spectrum atlas::ImageLibrary::privateSample(const ImageID id, const Point2f &uv, Float &alpha)
+atlas::Spectrum atlas::ImageLibrary::privateSample(const ImageID id, const Point2f &uv, Float width, Float &alpha)
 {
-	if (!images[id].isLoaded())
+	// The clock only moves every few hundred lookups of a thread, which is precise enough for the LRU
+	thread_local uint32_t lookups = 0;
+	if ((++lookups & 255) == 0)
+		nextCallValue.fetch_add(1, std::memory_order_relaxed);
+	const uint32_t callValue = nextCallValue.load(std::memory_order_relaxed);
+
+	if (id == InvalidID)
+	{
+		alpha = 1;
+		return (Spectrum(1, 0, 0));
+	}
+
+	ImageWrapper &image = *images[id];
+	size_t loadedBytes = 0;
+	if (!image.isLoaded())
 	{
-		// if need space, free the texture which spent the most time unused
-		if (!images[id].load())
+		loadedBytes = image.open(callValue);
+		if (!image.isLoaded())
 		{
 			alpha = 1;
 			return (Spectrum(1, 0, 0));
 		}
 	}
-	Spectrum color = images[id].sample(uv, nextCallValue, alpha);
-	nextCallValue++;
+	Spectrum color = image.sample(uv, width, callValue, alpha, loadedBytes);
+
+	if (loadedBytes > 0 && residentBytes.fetch_add(loadedBytes, std::memory_order_relaxed) + loadedBytes > memoryLimit)
+		evictLeastRecentlyUsed();
 	return (color);
-}
\ No newline at end of file
+}
+
+void atlas::ImageLibrary::evictLeastRecentlyUsed()
+{
+	// A single thread evicts at a time, the others keep rendering over the budget until it is done
+	std::unique_lock<std::mutex> lock(evictionGuard, std::try_to_lock);
+	if (!lock.owns_lock())
+		return;
+
+	const size_t resident = residentBytes.load(std::memory_order_relaxed);
+	if (resident <= memoryLimit)
+		return;
+
+	// Evict down to 90% of the budget so that a full cache does not evict on every miss
+	const size_t target = memoryLimit / 10 * 9;
+	const uint32_t count = imageCount.load(std::memory_order_acquire);
+	std::vector<std::pair<uint32_t, size_t>> ages;
+	// Images still being opened by another thread are skipped, their tiles are not published yet
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (images[i]->isLoaded())
+			images[i]->getTileAges(ages);
+	}
+	if (ages.empty())
+		return;
+
+	// Tiles do not have the same size for every encoding, the oldest ones are summed up to the amount to release.
+	// Every tile older than the boundary goes, the ones last used at the boundary only until enough is released:
+	// the tiles of an image loaded at once all have the same age.
+	std::sort(ages.begin(), ages.end());
+	const size_t toRelease = resident - std::min(target, resident);
+	size_t released = 0;
+	size_t olderBytes = 0;
+	uint32_t boundary = ages.front().first;
+	for (const std::pair<uint32_t, size_t> &age : ages)
+	{
+		if (age.first != boundary)
+		{
+			if (released >= toRelease)
+				break;
+			boundary = age.first;
+			olderBytes = released;
+		}
+		released += age.second;
+	}
+
+	size_t boundaryBytes = toRelease - olderBytes;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (images[i]->isLoaded())
+			residentBytes.fetch_sub(images[i]->evictTiles(boundary, boundaryBytes, retiredTiles), std::memory_order_relaxed);
+	}
+}
+
+void atlas::ImageLibrary::releaseRetiredTiles()
+{
+	std::lock_guard<std::mutex> lock(instance.evictionGuard);
+	for (uint8_t *texels : instance.retiredTiles)
+		delete[] texels;
+	instance.retiredTiles.clear();
+}
+
+void atlas::ImageLibrary::flushStatistics()
+{
+	ImageWrapper::flushPendingHits();
+}
+
+void atlas::ImageLibrary::report()
+{
+	flushStatistics();
+	std::cout << "Texture cache: " << getResidentBytes() / (1024 * 1024) << " / "
+		<< instance.memoryLimit / (1024 * 1024) << " MB resident" << std::endl;
+	const uint32_t count = instance.imageCount.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const ImageWrapper &image = *instance.images[i];
+		const TextureStatistics stats = image.getStatistics();
+		const uint64_t lookups = stats.hits + stats.misses;
+		std::cout << "\t" << image.getFilename() << ": " << lookups << " lookups, "
+			<< (lookups ? 100.0 * stats.hits / lookups : 100.0) << "% hits, "
+			<< stats.misses << " misses, " << stats.loads << " loads, "
+			<< stats.evictedTiles << " evicted tiles" << std::endl;
+	}
+}
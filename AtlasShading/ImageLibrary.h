@@ -1,6 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <emmintrin.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "atlas/Atlas.h"
@@ -8,53 +14,128 @@
 #include "atlas/core/Points.h"
 
 #include "AtlasShadingLibHeader.h"
+#include "TextureFile.h"
 #include "stb_image.h"
 
 namespace atlas
 {
 	typedef size_t ImageID;
 
+	struct TextureStatistics
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint32_t loads = 0;
+		uint32_t evictedTiles = 0;
+	};
+
+	// Mip-mapped image cut into square tiles. Tiles are built the first time they are needed
+	// and can be evicted one by one. Images in the .atx format are mapped and their tiles
+	// copied as they are, the others are decoded to RGBA8 on the first miss and their tiles
+	// filtered from the decoded source, which counts against the budget of the library and
+	// is evicted like a tile. It is decoded again on the next miss.
+	// Lookups of resident tiles never lock, the image is opened once by the first thread
+	// sampling it and only the threads missing a tile wait on the reload.
 	class ImageWrapper
 	{
 	public:
+		static constexpr int32_t TileSize = 64;
+		static constexpr size_t TileBytes = TileSize * TileSize * 4;
+
+		struct Tile
+		{
+			std::atomic<uint8_t *> texels = nullptr;
+			std::atomic<uint32_t> lastCallValue = 0;
+		};
+
+		struct Level
+		{
+			int32_t width = 0;
+			int32_t height = 0;
+			int32_t tilesX = 0;
+			int32_t tilesY = 0;
+			uint32_t firstTile = 0;
+		};
+
 		ImageWrapper(const std::string &filename)
-			: filename(filename), buffer(nullptr)
-			, width(0), height(0), lastCallValue(0)
-			, bIsLoaded(false), bHasAlpha(false)
+			: filename(filename)
 		{}
 
-		ATLAS_SH bool load();
-		ATLAS_SH void unload();
-		ATLAS_SH Spectrum sample(const Point2f &uv, const uint32_t callValue, Float &alpha);
+		ImageWrapper(const ImageWrapper &) = delete;
+		ImageWrapper &operator=(const ImageWrapper &) = delete;
+		ATLAS_SH ~ImageWrapper();
+
+		// Opens the image the first time it is called, returns the number of bytes made resident
+		ATLAS_SH size_t open(const uint32_t callValue);
+		// Trilinear lookup, width is the size of the filter footprint in uv space
+		ATLAS_SH Spectrum sample(const Point2f &uv, Float width, const uint32_t callValue, Float &alpha, size_t &loadedBytes);
+
+		// Detaches the tiles last used before boundary, and those last used at boundary while boundaryBytes
+		// remain. They are appended to retired and have to be kept alive until no thread is sampling anymore.
+		// The decoded source follows the same rule and is freed at once.
+		ATLAS_SH size_t evictTiles(const uint32_t boundary, size_t &boundaryBytes, std::vector<uint8_t *> &retired);
+		// Appends the last call value and the size of every resident tile, and of the decoded source
+		ATLAS_SH void getTileAges(std::vector<std::pair<uint32_t, size_t>> &ages) const;
 
 		inline const std::string &getFilename() const
 		{
 			return (filename);
 		}
 
-		inline uint32_t getLastCallValue() const
-		{
-			return (lastCallValue);
-		}
-
 		inline bool isLoaded() const
 		{
-			return (bIsLoaded);
+			return (bIsLoaded.load(std::memory_order_acquire));
 		}
 
+		ATLAS_SH TextureStatistics getStatistics() const;
+		// Adds the hits still held by the sampling threads, must only be called when no thread is sampling
+		ATLAS_SH static void flushPendingHits();
+
 	private:
 		std::string filename;
-		uint8_t *buffer;
-		int32_t width;
-		int32_t height;
-		uint32_t lastCallValue;
-		bool bIsLoaded;
-		bool bHasAlpha;
+		std::vector<Level> levels;
+		std::unique_ptr<Tile[]> tiles;
+		uint32_t tileCount = 0;
+		TileEncoding encoding = TileEncoding::Rgba8;
+		size_t tileBytes = TileBytes;
+		std::unique_ptr<TextureFile> file;
+		std::atomic<uint8_t *> source = nullptr;
+		std::atomic<uint32_t> sourceCallValue = 0;
+		size_t sourceBytes = 0;
+		std::atomic<size_t> residentBytes = 0;
+		std::atomic<bool> bIsLoaded = false;
+		bool bHasAlpha = false;
+
+		std::once_flag openFlag;
+		std::mutex reloadGuard;
+
+		std::atomic<uint64_t> hits = 0;
+		std::atomic<uint64_t> misses = 0;
+		std::atomic<uint32_t> loads = 0;
+		std::atomic<uint32_t> evictedTiles = 0;
+
+		ATLAS_SH size_t load(const uint32_t callValue);
+		ATLAS_SH size_t openTextureFile(const uint32_t callValue);
+		// Called with reloadGuard held
+		ATLAS_SH size_t decodeSource();
+		ATLAS_SH size_t loadTile(const Level &level, const uint32_t tile, const uint32_t callValue);
+		// Copies the tile out of the texels of its level, which start at its first texel
+		ATLAS_SH uint8_t *cutTile(const Level &level, int32_t tileX, int32_t tileY, const uint8_t *texels, int32_t stride) const;
+		// Texels [x0, x1) x [y0, y1) of a level filtered from the source, either in storage or in the source itself
+		ATLAS_SH const uint8_t *buildTexels(uint32_t level, int32_t x0, int32_t y0, int32_t x1, int32_t y1, std::vector<uint8_t> &storage, int32_t &stride) const;
+		ATLAS_SH bool bilinear(const Level &level, const Point2f &uv, const uint32_t callValue, __m128 &rgba, size_t &loadedBytes);
+		// Returns the tile holding the texel, x and y are wrapped and made relative to the tile
+		ATLAS_SH const uint8_t *getTile(const Level &level, int32_t &x, int32_t &y, const uint32_t callValue, size_t &loadedBytes);
 	};
 
 	class ImageLibrary
 	{
 	public:
+		static constexpr uint32_t MaxImages = 4096;
+		// Returned once MaxImages images are requested, sampling it gives the error color
+		static constexpr ImageID InvalidID = ~ImageID(0);
+
+		// Not meant to be called while rendering, the images are requested when the scene is built
 		inline static ImageID requestID(const std::string &filename)
 		{
 			return (instance.privateRequestID(filename));
@@ -62,15 +143,53 @@ namespace atlas
 
 		inline static Spectrum sample(const ImageID id, const Point2f &uv, Float &alpha)
 		{
-			return (instance.privateSample(id, uv, alpha));
+			return (instance.privateSample(id, uv, 0, alpha));
+		}
+
+		inline static Spectrum sample(const ImageID id, const Point2f &uv, Float width, Float &alpha)
+		{
+			return (instance.privateSample(id, uv, width, alpha));
+		}
+
+		// Budget shared by the tiles of every image, the least recently used tiles are evicted above it
+		inline static void setMemoryLimit(size_t bytes)
+		{
+			instance.memoryLimit = bytes;
+		}
+
+		inline static size_t getResidentBytes()
+		{
+			return (instance.residentBytes.load(std::memory_order_relaxed));
+		}
+
+		inline static TextureStatistics getStatistics(const ImageID id)
+		{
+			if (id == InvalidID)
+				return (TextureStatistics());
+			return (instance.images[id]->getStatistics());
 		}
 
+		// Frees the evicted tiles, must only be called when no thread is sampling
+		ATLAS_SH static void releaseRetiredTiles();
+		// Gathers the hits counted by every thread, must only be called when no thread is sampling
+		ATLAS_SH static void flushStatistics();
+		ATLAS_SH static void report();
+
 	private:
 		ATLAS_SH static ImageLibrary instance;
-		uint32_t nextCallValue = 0;
-		std::vector<ImageWrapper> images;
+		std::atomic<uint32_t> nextCallValue = 0;
+		size_t memoryLimit = size_t(2) << 30;
+		std::atomic<size_t> residentBytes = 0;
+
+		std::unique_ptr<ImageWrapper> images[MaxImages];
+		std::atomic<uint32_t> imageCount = 0;
+		std::mutex requestGuard;
+
+		std::mutex evictionGuard;
+		std::vector<uint8_t *> retiredTiles;
 
 		ATLAS_SH ImageID privateRequestID(const std::string &filename);
-		ATLAS_SH Spectrum privateSample(const ImageID id, const Point2f &uv, Float &alpha);
+		ATLAS_SH Spectrum privateSample(const ImageID id, const Point2f &uv, Float width, Float &alpha);
+		ATLAS_SH void evictLeastRecentlyUsed();
 	};
-}
\ No newline at end of file
+}
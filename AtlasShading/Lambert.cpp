@@ -7,11 +7,30 @@ atlas::Spectrum atlas::Lambert::f(const Vec3f &wo, const Vec3f &wi, const DataBl
 	return (iR.get(data));
 }
 
+void atlas::Lambert::evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, const Block<Point2f> &samples, DataBlock &block, Block<BSDFSample> &bsdfs) const
+{
+	const Spectrum *r = iR.getArray(block);
+	for (uint32_t i = 0; i < wo.size(); i++)
+	{
+		Onb uvw(si[i].n);
+		Vec3f wi = uvw.local(cosineSampleDirection(samples[i]));
+		Float cosine = dot(uvw.w, wi);
+
+		BSDFSample &bsdf = bsdfs[i];
+		bsdf.wi = wi;
+		bsdf.pdf = cosine * INV_PI;
+		bsdf.scatteringPdf = cosine < 0 ? 0 : cosine * INV_PI;
+		bsdf.Li = r[i];
+		bsdf.Le = BLACK;
+	}
+}
+
 std::shared_ptr<atlas::Material> atlas::createLambertMaterial(const Spectrum &r)
 {
 	std::shared_ptr<Material> m = std::make_shared<Material>();
 	Lambert &lambert = m->addEntryShader<Lambert>();
 	ConstantShader<Spectrum> &color = m->addConstant<Spectrum>(r);
 	lambert.iR.bind(color.out);
+	m->compile();
 	return (m);
 }
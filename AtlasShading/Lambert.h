@@ -9,7 +9,15 @@ namespace atlas
 
 	struct Lambert : public BSDFShader
 	{
+		using BSDFShader::evaluate;
+
+		void registerInputs(std::vector<ShadingInputBase *> &inputs) override
+		{
+			inputs.push_back(&iR);
+		}
+
 		ATLAS_SH Spectrum f(const Vec3f &wo, const Vec3f &wi, const DataBlock &block) const override;
+		ATLAS_SH void evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, const Block<Point2f> &samples, DataBlock &block, Block<BSDFSample> &bsdfs) const override;
 
 		ShadingInput<Spectrum> iR;
 	};
@@ -9,6 +9,7 @@
 #include "BSDF.h"
 #include "Shader.h"
 #include "BSDFShader.h"
+#include "ShaderGraph.h"
 #include "atlas/core/Block.h"
 
 namespace atlas
@@ -29,10 +30,7 @@ namespace atlas
 		inline T &addShader()
 		{
 			CHECK(entryShader);
-			T *ptr = new T;
-			ptr->registerOutputs(dataSize);
-			shaders.push_back(ptr);
-			return (*ptr);
+			return (graph.addShader<T>());
 		}
 
 		template <typename T>
@@ -43,41 +41,81 @@ namespace atlas
 			return (shader);
 		}
 
+		// To be called once the shaders are bound, see ShaderGraph::compile
+		void compile()
+		{
+			std::vector<ShadingInputBase *> inputs;
+			entryShader->registerInputs(inputs);
+			graph.compile(&inputs);
+		}
+
 		BSDFSample sample(const Vec3f &wo, const SurfaceInteraction &si, const Point2f &sample) const
 		{
-			BSDFSample bsdf;
-			{
-				DataBlock block(dataSize);
-				for (size_t i = shaders.size() - 1; i < shaders.size(); i--)
-				{
-					shaders[i]->evaluate(wo, si, block);
-				}
-				bsdf = entryShader->evaluate(wo, si, sample, block);
-			}
-			return (bsdf);
+			return (this->sample(wo, si, sample, getScratchBlock()));
 		}
 
 		BSDF evaluate(const Vec3f &wo, const Vec3f &wi, const SurfaceInteraction &si) const
 		{
-			BSDF bsdf;
-			{
-				DataBlock block(dataSize);
-				for (size_t i = shaders.size() - 1; i < shaders.size(); i--)
-				{
-					shaders[i]->evaluate(wo, si, block);
-				}
-				bsdf = entryShader->evaluate(wo, wi, si, block);
-			}
-			return (bsdf);
+			return (evaluate(wo, wi, si, getScratchBlock()));
+		}
+
+		// The block is caller provided scratch memory of at least getDataSize() bytes
+		BSDFSample sample(const Vec3f &wo, const SurfaceInteraction &si, const Point2f &sample, DataBlock &block) const
+		{
+			DCHECK(block.size() >= graph.getDataSize());
+			graph.evaluate(wo, si, block);
+			return (entryShader->evaluate(wo, si, sample, block));
+		}
+
+		BSDF evaluate(const Vec3f &wo, const Vec3f &wi, const SurfaceInteraction &si, DataBlock &block) const
+		{
+			DCHECK(block.size() >= graph.getDataSize());
+			graph.evaluate(wo, si, block);
+			return (entryShader->evaluate(wo, wi, si, block));
+		}
+
+		// Shades a whole range of interactions, the block is scratch memory of at least
+		// getDataSize() bytes per interaction. Every shader output is laid out as an array.
+		void sample(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, const Block<Point2f> &samples, Block<BSDFSample> &bsdfs, DataBlock &block) const
+		{
+			DCHECK(block.size() >= graph.getDataSize() * wo.size());
+			block.setLaneCount(wo.size());
+			graph.evaluate(wo, si, block);
+			entryShader->evaluate(wo, si, samples, block, bsdfs);
+			block.setLaneCount(1);
+		}
+
+		uint32_t getDataSize() const
+		{
+			return (graph.getDataSize());
+		}
+
+		// Written to the material ID output of the film, 0 is left to the background
+		void setID(uint32_t newID)
+		{
+			id = newID;
+		}
+
+		uint32_t getID() const
+		{
+			return (id);
 		}
 
 	private:
-		uint32_t dataSize = 0;
 		ShadingInput<BSDFSample> bsdfInput;
+		uint32_t id = 0;
 		
 		BSDFShader *entryShader;
-		std::vector<Shader *> shaders;
+		ShaderGraph graph;
 
 		// TODO support for bump
+
+		// Shared by all the materials evaluated on a thread, it only grows to the biggest dataSize
+		DataBlock &getScratchBlock() const
+		{
+			thread_local DataBlock block;
+			block.reserve(graph.getDataSize());
+			return (block);
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "PerlinNoise.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "atlas/core/Random.h"
+
+const atlas::PerlinNoise::Tables atlas::PerlinNoise::tables = atlas::PerlinNoise::generateTables();
+
+atlas::PerlinNoise::Tables atlas::PerlinNoise::generateTables()
+{
+	RNG rng(0x5eed);
+	Tables t;
+	for (uint32_t i = 0; i < PointCount; i++)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+			t.gradients[c][i] = 2 * rng.uniformFloat() - 1;
+	}
+
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		for (uint32_t i = 0; i < PointCount; i++)
+			t.perm[c][i] = i;
+		for (uint32_t i = PointCount - 1; i > 0; i--)
+			std::swap(t.perm[c][i], t.perm[c][rng.uniformUInt32(i + 1)]);
+	}
+	return (t);
+}
+
+Float atlas::PerlinNoise::noise(const Point3f &p)
+{
+	const Float fx = std::floor(p.x);
+	const Float fy = std::floor(p.y);
+	const Float fz = std::floor(p.z);
+	const Float u = p.x - fx;
+	const Float v = p.y - fy;
+	const Float w = p.z - fz;
+	const int32_t i = static_cast<int32_t>(fx);
+	const int32_t j = static_cast<int32_t>(fy);
+	const int32_t k = static_cast<int32_t>(fz);
+
+	const Float uu = u * u * (3 - 2 * u);
+	const Float vv = v * v * (3 - 2 * v);
+	const Float ww = w * w * (3 - 2 * w);
+
+	Float acc = 0;
+	for (int32_t corner = 0; corner < 8; corner++)
+	{
+		const int32_t di = corner & 1;
+		const int32_t dj = (corner >> 1) & 1;
+		const int32_t dk = corner >> 2;
+		const int32_t idx = tables.perm[0][(i + di) & 255] ^ tables.perm[1][(j + dj) & 255] ^ tables.perm[2][(k + dk) & 255];
+		const Float dot = tables.gradients[0][idx] * (u - di) + tables.gradients[1][idx] * (v - dj) + tables.gradients[2][idx] * (w - dk);
+		acc += (di ? uu : 1 - uu) * (dj ? vv : 1 - vv) * (dk ? ww : 1 - ww) * dot;
+	}
+	return (acc);
+}
+
+atlas::S4Float atlas::PerlinNoise::noise(const S4Float &x, const S4Float &y, const S4Float &z)
+{
+	const S4Float fx = floor(x);
+	const S4Float fy = floor(y);
+	const S4Float fz = floor(z);
+	const S4Float u = x - fx;
+	const S4Float v = y - fy;
+	const S4Float w = z - fz;
+
+	alignas(16) int32_t i[4];
+	alignas(16) int32_t j[4];
+	alignas(16) int32_t k[4];
+	_mm_store_si128(reinterpret_cast<__m128i *>(i), _mm_cvttps_epi32(fx.m));
+	_mm_store_si128(reinterpret_cast<__m128i *>(j), _mm_cvttps_epi32(fy.m));
+	_mm_store_si128(reinterpret_cast<__m128i *>(k), _mm_cvttps_epi32(fz.m));
+
+	const S4Float one(1.f);
+	const S4Float three(3.f);
+	const S4Float two(2.f);
+	const S4Float uu = u * u * (three - two * u);
+	const S4Float vv = v * v * (three - two * v);
+	const S4Float ww = w * w * (three - two * w);
+
+	// The gradients are gathered lane by lane, the interpolation runs on the four points at once
+	S4Float acc(0.f);
+	for (int32_t corner = 0; corner < 8; corner++)
+	{
+		const int32_t di = corner & 1;
+		const int32_t dj = (corner >> 1) & 1;
+		const int32_t dk = corner >> 2;
+
+		alignas(16) float gx[4];
+		alignas(16) float gy[4];
+		alignas(16) float gz[4];
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			const int32_t idx = tables.perm[0][(i[lane] + di) & 255] ^ tables.perm[1][(j[lane] + dj) & 255] ^ tables.perm[2][(k[lane] + dk) & 255];
+			gx[lane] = tables.gradients[0][idx];
+			gy[lane] = tables.gradients[1][idx];
+			gz[lane] = tables.gradients[2][idx];
+		}
+
+		const S4Float dot = S4Float(_mm_load_ps(gx)) * (u - S4Float((float)di))
+			+ S4Float(_mm_load_ps(gy)) * (v - S4Float((float)dj))
+			+ S4Float(_mm_load_ps(gz)) * (w - S4Float((float)dk));
+		const S4Float weight = (di ? uu : one - uu) * (dj ? vv : one - vv) * (dk ? ww : one - ww);
+		acc = acc + weight * dot;
+	}
+	return (acc);
+}
+
+Float atlas::PerlinNoise::turbulence(const Point3f &p, uint32_t depth)
+{
+	Point3f tmp = p;
+	Float acc = 0;
+	Float weight = 1;
+	for (uint32_t i = 0; i < depth; i++)
+	{
+		acc += weight * noise(tmp);
+		weight *= 0.5;
+		tmp *= 2;
+	}
+	return (std::abs(acc));
+}
+
+atlas::S4Float atlas::PerlinNoise::turbulence(S4Float x, S4Float y, S4Float z, const uint32_t depth[4])
+{
+	const uint32_t maxDepth = std::max(std::max(depth[0], depth[1]), std::max(depth[2], depth[3]));
+	const S4Float depths((float)depth[0], (float)depth[1], (float)depth[2], (float)depth[3]);
+
+	S4Float acc(0.f);
+	float weight = 1;
+	const S4Float two(2.f);
+	for (uint32_t i = 0; i < maxDepth; i++)
+	{
+		const S4Float octave = S4Float(weight) * noise(x, y, z);
+		acc = acc + select(S4Float(0.f), octave, S4Float((float)i) < depths);
+		weight *= 0.5f;
+		x = x * two;
+		y = y * two;
+		z = z * two;
+	}
+	return (abs(acc));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include "atlas/Atlas.h"
+#include "atlas/core/Points.h"
+#include "atlas/core/simd/Simd.h"
+
+#include "AtlasShadingLibHeader.h"
+
+namespace atlas
+{
+	// Gradient noise with tables shared by every noise shader. The tables are generated
+	// from a fixed seed so that the noise does not depend on the order materials are built in.
+	class PerlinNoise
+	{
+	public:
+		static constexpr uint32_t PointCount = 256;
+
+		ATLAS_SH static Float noise(const Point3f &p);
+		ATLAS_SH static S4Float noise(const S4Float &x, const S4Float &y, const S4Float &z);
+
+		// Absolute value of depth octaves summed with halved weights and doubled frequencies
+		ATLAS_SH static Float turbulence(const Point3f &p, uint32_t depth);
+		ATLAS_SH static S4Float turbulence(S4Float x, S4Float y, S4Float z, const uint32_t depth[4]);
+
+	private:
+		struct Tables
+		{
+			alignas(16) float gradients[3][PointCount];
+			int32_t perm[3][PointCount];
+		};
+
+		static const Tables tables;
+
+		static Tables generateTables();
+	};
+}
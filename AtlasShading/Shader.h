@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
 #include "atlas/core/Interaction.h"
 #include "ShadingIO.h"
 #include "atlas/core/Block.h"
@@ -9,8 +12,27 @@ namespace atlas
 	struct Shader
 	{
 		virtual void registerOutputs(uint32_t &size) = 0;
-		
+		virtual void registerInputs(std::vector<ShadingInputBase *> &inputs) = 0;
+
+		// Constant shaders only depend on their own parameters and are evaluated once by ShaderGraph::compile.
+		// They have a single output, which is copied to every lane afterward.
+		virtual bool isConstant() const
+		{
+			return (false);
+		}
+
 		virtual void evaluate(const Vec3f &wo, const SurfaceInteraction &si, DataBlock &block) const = 0;
+
+		// Evaluates a range of shading points at once, the block holds one lane per point.
+		// Shaders without a vectorized version are evaluated one lane at a time.
+		virtual void evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, DataBlock &block) const
+		{
+			for (uint32_t i = 0; i < wo.size(); i++)
+			{
+				block.setLane(i);
+				evaluate(wo[i], si[i], block);
+			}
+		}
 	};
 
 	template <typename T>
@@ -21,11 +43,24 @@ namespace atlas
 			out.registerOutput(size);
 		}
 
+		void registerInputs(std::vector<ShadingInputBase *> &inputs) override
+		{}
+
+		bool isConstant() const override
+		{
+			return (true);
+		}
+
 		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, DataBlock &block) const override
 		{
 			out.set(block, value);
 		}
 
+		void evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, DataBlock &block) const override
+		{
+			std::fill_n(out.getArray(block), wo.size(), value);
+		}
+
 		T value;
 		ShadingOutput<T> out;
 	};
@@ -0,0 +1,153 @@
+#include "ShaderGraph.h"
+
+namespace
+{
+	struct ShaderNode
+	{
+		atlas::Shader *shader = nullptr;
+		uint32_t start = 0;
+		uint32_t end = 0;
+		uint32_t newStart = 0;
+		std::vector<atlas::ShadingInputBase *> inputs;
+		bool live = false;
+		uint8_t visitState = 0;
+	};
+
+	int32_t findProducer(const std::vector<ShaderNode> &nodes, uint32_t pos)
+	{
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			if (pos >= nodes[i].start && pos < nodes[i].end)
+				return (static_cast<int32_t>(i));
+		}
+		return (-1);
+	}
+
+	void sortByDependency(std::vector<ShaderNode> &nodes, uint32_t idx, std::vector<uint32_t> &order)
+	{
+		if (nodes[idx].visitState == 2)
+			return;
+		CHECK(nodes[idx].visitState == 0); // cycle in the shader graph
+		nodes[idx].visitState = 1;
+		for (const atlas::ShadingInputBase *input : nodes[idx].inputs)
+		{
+			int32_t producer = findProducer(nodes, input->getPos());
+			if (producer >= 0)
+				sortByDependency(nodes, producer, order);
+		}
+		nodes[idx].visitState = 2;
+		order.push_back(idx);
+	}
+}
+
+void atlas::ShaderGraph::compile(const std::vector<ShadingInputBase *> *liveInputs)
+{
+	CHECK(!compiled);
+
+	// Outputs were registered in insertion order, registering them again gives back the same layout
+	std::vector<ShaderNode> nodes(shaders.size());
+	uint32_t size = 0;
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		nodes[i].shader = shaders[i];
+		nodes[i].start = size;
+		shaders[i]->registerOutputs(size);
+		nodes[i].end = size;
+		shaders[i]->registerInputs(nodes[i].inputs);
+	}
+	CHECK(size == dataSize);
+
+	std::vector<uint32_t> toVisit;
+	auto markProducer = [&](const ShadingInputBase *input)
+	{
+		int32_t producer = findProducer(nodes, input->getPos());
+		if (producer >= 0 && !nodes[producer].live)
+		{
+			nodes[producer].live = true;
+			toVisit.push_back(producer);
+		}
+	};
+
+	if (liveInputs)
+	{
+		for (const ShadingInputBase *input : *liveInputs)
+			markProducer(input);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < nodes.size(); i++)
+		{
+			nodes[i].live = true;
+			toVisit.push_back(i);
+		}
+	}
+
+	while (!toVisit.empty())
+	{
+		uint32_t idx = toVisit.back();
+		toVisit.pop_back();
+		for (const ShadingInputBase *input : nodes[idx].inputs)
+			markProducer(input);
+	}
+
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i].live)
+			sortByDependency(nodes, i, order);
+	}
+
+	// Constants are packed first so that they are evaluated once in a block of their own
+	uint32_t newSize = 0;
+	for (uint32_t idx : order)
+	{
+		if (nodes[idx].shader->isConstant())
+		{
+			nodes[idx].newStart = newSize;
+			nodes[idx].shader->registerOutputs(newSize);
+		}
+	}
+	const uint32_t constantSize = newSize;
+	for (uint32_t idx : order)
+	{
+		if (!nodes[idx].shader->isConstant())
+		{
+			nodes[idx].newStart = newSize;
+			nodes[idx].shader->registerOutputs(newSize);
+		}
+	}
+
+	auto rebind = [&](ShadingInputBase *input)
+	{
+		int32_t producer = findProducer(nodes, input->getPos());
+		if (producer >= 0)
+			input->setPos(nodes[producer].newStart + input->getPos() - nodes[producer].start);
+	};
+
+	std::vector<ShadingInputBase *> inputs;
+	for (uint32_t idx : order)
+		inputs.insert(inputs.end(), nodes[idx].inputs.begin(), nodes[idx].inputs.end());
+	if (liveInputs)
+		inputs.insert(inputs.end(), liveInputs->begin(), liveInputs->end());
+	for (ShadingInputBase *input : inputs)
+		rebind(input);
+
+	DataBlock constantBlock(constantSize);
+	Vec3f wo;
+	SurfaceInteraction si;
+	for (uint32_t idx : order)
+	{
+		if (nodes[idx].shader->isConstant())
+		{
+			nodes[idx].shader->evaluate(wo, si, constantBlock);
+			constants.push_back({ nodes[idx].newStart, nodes[idx].end - nodes[idx].start });
+		}
+		else
+			program.push_back(nodes[idx].shader);
+	}
+	if (constantSize > 0)
+		constantData.assign(constantBlock.getArray<uint8_t>(0), constantBlock.getArray<uint8_t>(0) + constantSize);
+
+	dataSize = newSize;
+	compiled = true;
+}
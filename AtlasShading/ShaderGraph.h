@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "atlas/core/Block.h"
+#include "atlas/core/Logging.h"
+
+#include "AtlasShadingLibHeader.h"
+#include "Shader.h"
+#include "ShadingIO.h"
+
+namespace atlas
+{
+	// Owns the shaders of a Material or a ShaderGroup. Until compile() is called the shaders
+	// are evaluated back to front, in the order they were added.
+	class ShaderGraph
+	{
+	public:
+		template <typename T>
+		T &addShader()
+		{
+			CHECK(!compiled);
+			T *ptr = new T;
+			ptr->registerOutputs(dataSize);
+			shaders.push_back(ptr);
+			return (*ptr);
+		}
+
+		// Folds the constant shaders into values copied to every lane once per evaluation, drops the shaders
+		// that do not feed any of the given inputs, orders the others by dependency and packs
+		// their outputs tightly. Every shader is kept when liveInputs is null.
+		ATLAS_SH void compile(const std::vector<ShadingInputBase *> *liveInputs);
+
+		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, DataBlock &block) const
+		{
+			if (!compiled)
+			{
+				for (size_t i = shaders.size() - 1; i < shaders.size(); i--)
+					shaders[i]->evaluate(wo, si, block);
+				return;
+			}
+
+			setConstants(block, block.getLane(), block.getLane() + 1);
+			for (const Shader *shader : program)
+				shader->evaluate(wo, si, block);
+		}
+
+		void evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, DataBlock &block) const
+		{
+			if (!compiled)
+			{
+				for (size_t i = shaders.size() - 1; i < shaders.size(); i--)
+					shaders[i]->evaluate(wo, si, block);
+				return;
+			}
+
+			setConstants(block, 0, wo.size());
+			for (const Shader *shader : program)
+				shader->evaluate(wo, si, block);
+		}
+
+		uint32_t getDataSize() const
+		{
+			return (dataSize);
+		}
+
+		bool isCompiled() const
+		{
+			return (compiled);
+		}
+
+	private:
+		struct ConstantOutput
+		{
+			uint32_t pos;
+			uint32_t size;
+		};
+
+		// Constant outputs are laid out like any other value, an element per lane starting at pos * laneCount
+		void setConstants(DataBlock &block, uint32_t firstLane, uint32_t lastLane) const
+		{
+			for (const ConstantOutput &constant : constants)
+			{
+				uint8_t *dst = block.getArray<uint8_t>(constant.pos);
+				for (uint32_t lane = firstLane; lane < lastLane; lane++)
+					std::memcpy(dst + lane * constant.size, &constantData[constant.pos], constant.size);
+			}
+		}
+
+		bool compiled = false;
+		uint32_t dataSize = 0;
+		std::vector<Shader *> shaders;
+
+		std::vector<ConstantOutput> constants;
+		std::vector<const Shader *> program;
+		std::vector<uint8_t> constantData;
+	};
+}
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "Shader.h"
+#include "ShaderGraph.h"
 
 namespace atlas
 {
@@ -15,24 +16,23 @@ namespace atlas
 		template <typename T>
 		T &addShader()
 		{
-			T *ptr = new T;
-			ptr->registerOutputs(dataSize);
-			shaders.push_back(ptr);
-			return (*ptr);
+			return (graph.addShader<T>());
 		}
 
-		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, const Point2f &sample, DataBlock &block) const
+		// The outputs of a group are read from outside of it, so none of its shaders are pruned
+		void compile()
 		{
-			for (uint32_t i = shaders.size() - 1; i < shaders.size(); i--)
-			{
-				shaders[i]->evaluate(wo, si, sample, block);
-			}
+			graph.compile(nullptr);
+		}
+
+		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, DataBlock &block) const
+		{
+			graph.evaluate(wo, si, block);
 		}
 
 	private:
 		friend class ShaderGroupBind;
-		uint32_t dataSize = 0;
-		std::vector<Shader *> shaders;
+		ShaderGraph graph;
 		std::vector<ShadingOutput<uint8_t>> outputs;
 	};
 
@@ -41,13 +41,16 @@ namespace atlas
 		virtual void registerOutputs(uint32_t &size) override
 		{
 			start = size;
-			size += group->dataSize;
+			size += group->graph.getDataSize();
 		}
 
-		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, const Point2f &sample, DataBlock &block) const override
+		void registerInputs(std::vector<ShadingInputBase *> &inputs) override
+		{}
+
+		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, DataBlock &block) const override
 		{
-			DataBlock subBlock(block, start, group->dataSize);
-			group->evaluate(wo, si, sample, subBlock);
+			DataBlock subBlock(block, start, group->graph.getDataSize());
+			group->evaluate(wo, si, subBlock);
 		}
 
 	private:
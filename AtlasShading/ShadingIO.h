@@ -34,6 +34,11 @@ namespace atlas
 			return (block.get<T>(pos));
 		}
 
+		T *getArray(DataBlock &block) const
+		{
+			return (block.getArray<T>(pos));
+		}
+
 		uint32_t getPos() const
 		{
 			CHECK(pos != -1);
@@ -43,8 +48,25 @@ namespace atlas
 		uint32_t pos = -1;
 	};
 
+	class ShadingInputBase
+	{
+	public:
+		uint32_t getPos() const
+		{
+			return (pos);
+		}
+
+		void setPos(uint32_t p)
+		{
+			pos = p;
+		}
+
+	protected:
+		uint32_t pos = -1;
+	};
+
 	template <typename T>
-	class ShadingInput
+	class ShadingInput : public ShadingInputBase
 	{
 	public:
 		void bind(const ShadingOutput<T> &o)
@@ -57,7 +79,9 @@ namespace atlas
 			return (block.get<T>(pos));
 		}
 
-	private:
-		uint32_t pos = -1;
+		const T *getArray(const DataBlock &block) const
+		{
+			return (block.getArray<T>(pos));
+		}
 	};
 }
\ No newline at end of file
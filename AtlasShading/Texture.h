@@ -3,9 +3,8 @@
 #include "AtlasShadingLibHeader.h"
 #include "Shader.h"
 
-#include "atlas/core/Random.h"
-
 #include "ImageLibrary.h"
+#include "PerlinNoise.h"
 
 namespace atlas
 {
@@ -25,6 +24,13 @@ namespace atlas
 
 	struct CheckerTexture : public Texture
 	{
+		void registerInputs(std::vector<ShadingInputBase *> &inputs) override
+		{
+			inputs.push_back(&iColor1);
+			inputs.push_back(&iColor2);
+			inputs.push_back(&iScale);
+		}
+
 		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, DataBlock &block) const override
 		{
 			Float scale = iScale.get(block);
@@ -33,6 +39,22 @@ namespace atlas
 			oAlpha.set(block, 1);
 		}
 
+		void evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, DataBlock &block) const override
+		{
+			const Float *scales = iScale.getArray(block);
+			const Spectrum *colors1 = iColor1.getArray(block);
+			const Spectrum *colors2 = iColor2.getArray(block);
+			Spectrum *colors = oColor.getArray(block);
+			Float *alphas = oAlpha.getArray(block);
+			for (uint32_t i = 0; i < wo.size(); i++)
+			{
+				const Point3f &p = si[i].p;
+				Float sines = sin(p.x * scales[i]) * sin(p.y * scales[i]) * sin(p.z * scales[i]);
+				colors[i] = sines < 0 ? colors1[i] : colors2[i];
+				alphas[i] = 1;
+			}
+		}
+
 		ShadingInput<Spectrum> iColor1;
 		ShadingInput<Spectrum> iColor2;
 		ShadingInput<Float> iScale;
@@ -40,147 +62,124 @@ namespace atlas
 
 	struct NoiseTexture : public Texture
 	{
-		Float noise(const Point3f &p) const
+		void registerInputs(std::vector<ShadingInputBase *> &inputs) override
 		{
-			auto u = p.x - std::floor(p.x);
-			auto v = p.y - std::floor(p.y);
-			auto w = p.z - std::floor(p.z);
-
-			auto i = static_cast<int>(std::floor(p.x));
-			auto j = static_cast<int>(std::floor(p.y));
-			auto k = static_cast<int>(std::floor(p.z));
-
-			Vec3 c[2][2][2];
-			for (uint8_t di = 0; di < 2; di++)
-			{
-				for (uint8_t dj = 0; dj < 2; dj++)
-				{
-					for (uint8_t dk = 0; dk < 2; dk++)
-					{
-						c[di][dj][dk] = ranVec[permX[(i + di) & 255] ^ permY[(j + dj) & 255] ^ permZ[(k + dk) & 255]];
-					}
-				}
-			}
-
-			return (perlinInterpolation(c, u, v, w));
+			inputs.push_back(&iScale);
 		}
 
 		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, DataBlock &block) const override
 		{
 			Float scale = iScale.get(block);
 			Point3f p = scale * si.p;
-			Float value = (Float)0.5 * ((Float)1 + noise(p));
+			Float value = (Float)0.5 * ((Float)1 + PerlinNoise::noise(p));
 			oColor.set(block, Spectrum(value));
 			oAlpha.set(block, value);
 		}
 
-		ShadingInput<Float> iScale;
-
-		NoiseTexture()
-		{
-			ranVec = new Vec3[PointCount];
-			for (uint32_t i = 0; i < PointCount; i++)
-				ranVec[i] = 2.f * Vec3(random(), random(), random()) - Vec3(1);
-
-			permX = generatePerm();
-			permY = generatePerm();
-			permZ = generatePerm();
-		}
-
-		~NoiseTexture()
-		{
-			delete[] ranVec;
-			delete[] permX;
-			delete[] permY;
-			delete[] permZ;
-		}
-
-	private:
-		static constexpr uint32_t PointCount = 256;
-		Vec3 *ranVec;
-		int *permX;
-		int *permY;
-		int *permZ;
-
-		static int *generatePerm()
-		{
-			auto p = new int[PointCount];
-			for (uint32_t i = 0; i < PointCount; i++)
-				p[i] = i;
-
-			permute(p, PointCount);
-
-			return (p);
-		}
-
-		static void permute(int *p, int n)
+		void evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, DataBlock &block) const override
 		{
-			for (int i = n - 1; i >= 0; i--)
+			const Float *scales = iScale.getArray(block);
+			Spectrum *colors = oColor.getArray(block);
+			Float *alphas = oAlpha.getArray(block);
+			for (uint32_t i = 0; i < wo.size(); i += 4)
 			{
-				int target = (int)(random() * (float)i);
-				int tmp = p[i];
-				p[i] = p[target];
-				p[target] = tmp;
-			}
-		}
+				alignas(16) float x[4];
+				alignas(16) float y[4];
+				alignas(16) float z[4];
+				const uint32_t count = std::min(wo.size() - i, 4u);
+				for (uint32_t lane = 0; lane < 4; lane++)
+				{
+					const uint32_t idx = i + std::min(lane, count - 1);
+					x[lane] = (float)(si[idx].p.x * scales[idx]);
+					y[lane] = (float)(si[idx].p.y * scales[idx]);
+					z[lane] = (float)(si[idx].p.z * scales[idx]);
+				}
 
-		static Float perlinInterpolation(Vec3 c[2][2][2], Float u, Float v, Float w)
-		{
-			Float acc = 0;
-			auto uu = u * u * (3 - 2 * u);
-			auto vv = v * v * (3 - 2 * v);
-			auto ww = w * w * (3 - 2 * w);
-			for (uint8_t i = 0; i < 2; i++)
-			{
-				for (uint8_t j = 0; j < 2; j++)
+				alignas(16) float values[4];
+				_mm_store_ps(values, PerlinNoise::noise(S4Float(x), S4Float(y), S4Float(z)).m);
+				for (uint32_t lane = 0; lane < count; lane++)
 				{
-					for (uint8_t k = 0; k < 2; k++)
-					{
-						Vec3 weight(u - i, v - j, w - k);
-						acc += (i * uu + (1 - i) * (1 - uu))
-							* (j * vv + (1 - j) * (1 - vv))
-							* (k * ww + (1 - k) * (1 - ww))
-							* dot(c[i][j][k], weight);
-					}
+					Float value = (Float)0.5 * ((Float)1 + values[lane]);
+					colors[i + lane] = Spectrum(value);
+					alphas[i + lane] = value;
 				}
 			}
-			return (acc);
 		}
+
+		ShadingInput<Float> iScale;
 	};
 
 	struct TurbulenceNoiseTexture : public NoiseTexture
 	{
+		void registerInputs(std::vector<ShadingInputBase *> &inputs) override
+		{
+			NoiseTexture::registerInputs(inputs);
+			inputs.push_back(&iDepth);
+		}
+
 		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, DataBlock &block) const override
 		{
 			Float scale = iScale.get(block);
 			uint32_t depth = iDepth.get(block);
-			Point3f p = si.p * scale;
+			Float turbulence = PerlinNoise::turbulence(si.p * scale, depth);
 
-			Float acc = 0;
-			Float weight = 1;
-			for (uint32_t i = 0; i < depth; i++)
-			{
-				acc += weight * noise(p);
-				weight *= 0.5;
-				p *= 2;
-			}
-
-			Float value = (Float)0.5 * ((Float)1 + sin(scale * si.p.z + (Float)10 * fabs(acc)));
+			Float value = (Float)0.5 * ((Float)1 + sin(scale * si.p.z + (Float)10 * turbulence));
 			oColor.set(block, Spectrum(value));
 			oAlpha.set(block, value);
 		}
 
+		void evaluate(const Block<Vec3f> &wo, const Block<SurfaceInteraction> &si, DataBlock &block) const override
+		{
+			const Float *scales = iScale.getArray(block);
+			const uint32_t *depths = iDepth.getArray(block);
+			Spectrum *colors = oColor.getArray(block);
+			Float *alphas = oAlpha.getArray(block);
+			for (uint32_t i = 0; i < wo.size(); i += 4)
+			{
+				alignas(16) float x[4];
+				alignas(16) float y[4];
+				alignas(16) float z[4];
+				uint32_t depth[4];
+				const uint32_t count = std::min(wo.size() - i, 4u);
+				for (uint32_t lane = 0; lane < 4; lane++)
+				{
+					const uint32_t idx = i + std::min(lane, count - 1);
+					x[lane] = (float)(si[idx].p.x * scales[idx]);
+					y[lane] = (float)(si[idx].p.y * scales[idx]);
+					z[lane] = (float)(si[idx].p.z * scales[idx]);
+					depth[lane] = depths[idx];
+				}
+
+				alignas(16) float turbulence[4];
+				_mm_store_ps(turbulence, PerlinNoise::turbulence(S4Float(x), S4Float(y), S4Float(z), depth).m);
+				for (uint32_t lane = 0; lane < count; lane++)
+				{
+					const uint32_t idx = i + lane;
+					Float value = (Float)0.5 * ((Float)1 + sin(scales[idx] * si[idx].p.z + (Float)10 * turbulence[lane]));
+					colors[idx] = Spectrum(value);
+					alphas[idx] = value;
+				}
+			}
+		}
+
 		ShadingInput<uint32_t> iDepth;
 	};
 
 	struct ImageTexture : public Texture
 	{
+		void registerInputs(std::vector<ShadingInputBase *> &inputs) override
+		{
+			inputs.push_back(&iOffset);
+		}
+
 		void evaluate(const Vec3f &wo, const SurfaceInteraction &si, DataBlock &block) const override
 		{
 			Vec2f offset = iOffset.get(block);
 
+			const Float width = 2 * std::max(std::max(std::abs(si.dudx), std::abs(si.dvdx)),
+				std::max(std::abs(si.dudy), std::abs(si.dvdy)));
 			Float alpha;
-			Spectrum color = ImageLibrary::sample(imageID, si.uv + offset, alpha);
+			Spectrum color = ImageLibrary::sample(imageID, si.uv + offset, width, alpha);
 			oColor.set(block, color);
 			oAlpha.set(block, alpha);
 		}
@@ -0,0 +1,319 @@
+#include "TextureFile.h"
+
+// Need to be above of the other include
+#include <windows.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <vector>
+
+#include "stb_image.h"
+
+namespace
+{
+	struct FloatImage
+	{
+		int32_t width = 0;
+		int32_t height = 0;
+		std::vector<float> texels;
+
+		const float *at(int32_t x, int32_t y) const
+		{
+			return (&texels[(std::min(x, width - 1) + std::min(y, height - 1) * width) * 4]);
+		}
+	};
+
+	FloatImage downsample(const FloatImage &src)
+	{
+		FloatImage dst;
+		dst.width = std::max(1, src.width / 2);
+		dst.height = std::max(1, src.height / 2);
+		dst.texels.resize(dst.width * dst.height * 4);
+		for (int32_t y = 0; y < dst.height; y++)
+		{
+			for (int32_t x = 0; x < dst.width; x++)
+			{
+				const float *t00 = src.at(2 * x, 2 * y);
+				const float *t10 = src.at(2 * x + 1, 2 * y);
+				const float *t01 = src.at(2 * x, 2 * y + 1);
+				const float *t11 = src.at(2 * x + 1, 2 * y + 1);
+				for (int32_t c = 0; c < 4; c++)
+					dst.texels[(x + y * dst.width) * 4 + c] = (t00[c] + t10[c] + t01[c] + t11[c]) * 0.25f;
+			}
+		}
+		return (dst);
+	}
+
+	uint16_t toRgb565(const float *rgb)
+	{
+		const uint32_t r = (uint32_t)(std::clamp(rgb[0], 0.f, 1.f) * 31 + 0.5f);
+		const uint32_t g = (uint32_t)(std::clamp(rgb[1], 0.f, 1.f) * 63 + 0.5f);
+		const uint32_t b = (uint32_t)(std::clamp(rgb[2], 0.f, 1.f) * 31 + 0.5f);
+		return (static_cast<uint16_t>((r << 11) | (g << 5) | b));
+	}
+
+	// Endpoints are the corners of the color bounding box inset by 1/16th,
+	// blocks with transparent texels use the 3 colors mode.
+	void encodeBc1Block(const float block[16][4], bool hasAlpha, uint8_t *dst)
+	{
+		float minColor[3] = { 1, 1, 1 };
+		float maxColor[3] = { 0, 0, 0 };
+		bool transparent = false;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				minColor[c] = std::min(minColor[c], block[i][c]);
+				maxColor[c] = std::max(maxColor[c], block[i][c]);
+			}
+			transparent |= hasAlpha && block[i][3] < 0.5f;
+		}
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			const float inset = (maxColor[c] - minColor[c]) / 16;
+			minColor[c] += inset;
+			maxColor[c] -= inset;
+		}
+
+		uint16_t c0 = toRgb565(maxColor);
+		uint16_t c1 = toRgb565(minColor);
+		if (transparent ? c0 > c1 : c0 < c1)
+			std::swap(c0, c1);
+
+		int32_t palette[4][4];
+		atlas::decodeBc1Palette(c0, c1, palette);
+		const uint32_t colorCount = c0 > c1 ? 4 : 3;
+
+		uint32_t indices = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t best = 0;
+			if (transparent && block[i][3] < 0.5f)
+				best = 3;
+			else
+			{
+				float bestDistance = INFINITY;
+				for (uint32_t j = 0; j < colorCount; j++)
+				{
+					float distance = 0;
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						const float d = std::clamp(block[i][c], 0.f, 1.f) * 255 - palette[j][c];
+						distance += d * d;
+					}
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = j;
+					}
+				}
+			}
+			indices |= best << (2 * i);
+		}
+		std::memcpy(dst, &c0, sizeof(c0));
+		std::memcpy(dst + 2, &c1, sizeof(c1));
+		std::memcpy(dst + 4, &indices, sizeof(indices));
+	}
+
+	void encodeTile(const FloatImage &level, int32_t tileX, int32_t tileY, int32_t tileSize, atlas::TileEncoding encoding, bool hasAlpha, uint8_t *dst)
+	{
+		const int32_t x0 = tileX * tileSize;
+		const int32_t y0 = tileY * tileSize;
+		if (encoding == atlas::TileEncoding::Bc1)
+		{
+			float block[16][4];
+			for (int32_t by = 0; by < tileSize / 4; by++)
+			{
+				for (int32_t bx = 0; bx < tileSize / 4; bx++)
+				{
+					for (int32_t i = 0; i < 16; i++)
+						std::memcpy(block[i], level.at(x0 + bx * 4 + i % 4, y0 + by * 4 + i / 4), sizeof(block[i]));
+					encodeBc1Block(block, hasAlpha, &dst[(bx + by * (tileSize / 4)) * 8]);
+				}
+			}
+			return;
+		}
+
+		for (int32_t y = 0; y < tileSize; y++)
+		{
+			for (int32_t x = 0; x < tileSize; x++)
+			{
+				const float *texel = level.at(x0 + x, y0 + y);
+				for (int32_t c = 0; c < 4; c++)
+				{
+					if (encoding == atlas::TileEncoding::Half)
+					{
+						const uint16_t half = atlas::toHalf(texel[c]);
+						std::memcpy(&dst[((x + y * tileSize) * 4 + c) * 2], &half, sizeof(half));
+					}
+					else
+						dst[(x + y * tileSize) * 4 + c] = (uint8_t)(std::clamp(texel[c], 0.f, 1.f) * 255 + 0.5f);
+				}
+			}
+		}
+	}
+}
+
+atlas::TextureFile::~TextureFile()
+{
+	close();
+}
+
+bool atlas::TextureFile::open(const std::string &filename)
+{
+	close();
+
+	file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		return (false);
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(TextureFileHeader))
+	{
+		close();
+		return (false);
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		close();
+		return (false);
+	}
+	data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		close();
+		return (false);
+	}
+
+	header = reinterpret_cast<const TextureFileHeader *>(data);
+	levels = reinterpret_cast<const TextureFileLevel *>(data + sizeof(TextureFileHeader));
+	tileBytes = atlas::getTileBytes(header->encoding, header->tileSize);
+	if (!isValid())
+	{
+		close();
+		return (false);
+	}
+	return (true);
+}
+
+bool atlas::TextureFile::isValid() const
+{
+	// Everything read from the mapping is checked once here, the accessors do not check anything
+	if (header->magic != TextureFileHeader::Magic || header->encoding > TileEncoding::Bc1
+		|| header->tileSize == 0 || header->tileSize % 4 != 0 || header->levelCount == 0)
+		return (false);
+	if (sizeof(TextureFileHeader) + uint64_t(header->levelCount) * sizeof(TextureFileLevel) > size
+		|| header->dataOffset > size || uint64_t(header->tileCount) * tileBytes > size - header->dataOffset)
+		return (false);
+
+	for (uint32_t i = 0; i < header->levelCount; i++)
+	{
+		const TextureFileLevel &level = levels[i];
+		if (level.width <= 0 || level.height <= 0
+			|| level.tilesX != (int64_t(level.width) + header->tileSize - 1) / header->tileSize
+			|| level.tilesY != (int64_t(level.height) + header->tileSize - 1) / header->tileSize
+			|| uint64_t(level.firstTile) + uint64_t(level.tilesX) * level.tilesY > header->tileCount)
+			return (false);
+	}
+	return (true);
+}
+
+void atlas::TextureFile::close()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	file = nullptr;
+	mapping = nullptr;
+	data = nullptr;
+	header = nullptr;
+	levels = nullptr;
+	size = 0;
+}
+
+bool atlas::TextureFile::convert(const std::string &src, const std::string &dst, TileEncoding encoding)
+{
+	// HDR images are kept linear, the others keep their 8 bits values
+	int32_t width;
+	int32_t height;
+	int nbComp;
+	FloatImage image;
+	if (stbi_is_hdr(src.c_str()))
+	{
+		float *buffer = stbi_loadf(src.c_str(), &width, &height, &nbComp, 4);
+		if (!buffer)
+			return (false);
+		image.texels.assign(buffer, buffer + width * height * 4);
+		stbi_image_free(buffer);
+	}
+	else
+	{
+		uint8_t *buffer = stbi_load(src.c_str(), &width, &height, &nbComp, 4);
+		if (!buffer)
+			return (false);
+		image.texels.resize(width * height * 4);
+		for (size_t i = 0; i < image.texels.size(); i++)
+			image.texels[i] = buffer[i] / 255.f;
+		stbi_image_free(buffer);
+	}
+	image.width = width;
+	image.height = height;
+
+	std::vector<FloatImage> pyramid;
+	pyramid.push_back(std::move(image));
+	while (pyramid.back().width > 1 || pyramid.back().height > 1)
+		pyramid.push_back(downsample(pyramid.back()));
+
+	TextureFileHeader header;
+	header.encoding = encoding;
+	header.tileSize = DefaultTileSize;
+	header.levelCount = static_cast<uint32_t>(pyramid.size());
+	header.hasAlpha = nbComp == 4;
+
+	std::vector<TextureFileLevel> levels(pyramid.size());
+	for (size_t i = 0; i < pyramid.size(); i++)
+	{
+		levels[i].width = pyramid[i].width;
+		levels[i].height = pyramid[i].height;
+		levels[i].tilesX = (pyramid[i].width + DefaultTileSize - 1) / DefaultTileSize;
+		levels[i].tilesY = (pyramid[i].height + DefaultTileSize - 1) / DefaultTileSize;
+		levels[i].firstTile = header.tileCount;
+		header.tileCount += levels[i].tilesX * levels[i].tilesY;
+	}
+
+	// Tiles start on a page boundary
+	const size_t tableSize = sizeof(TextureFileHeader) + levels.size() * sizeof(TextureFileLevel);
+	header.dataOffset = (tableSize + 4095) & ~size_t(4095);
+
+	std::ofstream out(dst, std::ios::binary);
+	if (!out)
+		return (false);
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char *>(levels.data()), levels.size() * sizeof(TextureFileLevel));
+	std::vector<char> padding(header.dataOffset - tableSize, 0);
+	out.write(padding.data(), padding.size());
+
+	std::vector<uint8_t> tile(atlas::getTileBytes(encoding, DefaultTileSize));
+	for (size_t i = 0; i < pyramid.size(); i++)
+	{
+		for (int32_t tileY = 0; tileY < levels[i].tilesY; tileY++)
+		{
+			for (int32_t tileX = 0; tileX < levels[i].tilesX; tileX++)
+			{
+				encodeTile(pyramid[i], tileX, tileY, DefaultTileSize, encoding, header.hasAlpha, tile.data());
+				out.write(reinterpret_cast<const char *>(tile.data()), tile.size());
+			}
+		}
+	}
+	return (out.good());
+}
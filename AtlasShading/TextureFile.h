@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
+#include <string>
+
+#include "atlas/core/Half.h"
+
+#include "AtlasShadingLibHeader.h"
+
+namespace atlas
+{
+	enum class TileEncoding : uint32_t
+	{
+		Rgba8 = 0,
+		Half = 1, // four halves per texel, values normalized so that 1 is white
+		Bc1 = 2 // 4x4 blocks of two 565 endpoints and 2 bits indices
+	};
+
+	// A .atx file holds a header, one TextureFileLevel per mip level and then the tiles
+	// of every level one after the other. Tiles have a fixed size for a given encoding,
+	// a tile is found from its index only and is paged in from a mapping of the file.
+	struct TextureFileHeader
+	{
+		static constexpr uint32_t Magic = 0x31585441; // ATX1
+
+		uint32_t magic = Magic;
+		TileEncoding encoding = TileEncoding::Rgba8;
+		uint32_t tileSize = 0;
+		uint32_t levelCount = 0;
+		uint32_t hasAlpha = 0;
+		uint32_t tileCount = 0;
+		uint64_t dataOffset = 0;
+	};
+
+	struct TextureFileLevel
+	{
+		int32_t width = 0;
+		int32_t height = 0;
+		int32_t tilesX = 0;
+		int32_t tilesY = 0;
+		uint32_t firstTile = 0;
+		uint32_t padding = 0;
+	};
+
+	inline size_t getTileBytes(TileEncoding encoding, int32_t tileSize)
+	{
+		switch (encoding)
+		{
+		case TileEncoding::Half:
+			return (size_t(tileSize) * tileSize * 8);
+		case TileEncoding::Bc1:
+			return (size_t(tileSize / 4) * (tileSize / 4) * 8);
+		default:
+			return (size_t(tileSize) * tileSize * 4);
+		}
+	}
+
+	inline void decodeBc1Palette(uint16_t c0, uint16_t c1, int32_t palette[4][4])
+	{
+		const uint16_t endpoints[2] = { c0, c1 };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			const int32_t r = (endpoints[i] >> 11) & 31;
+			const int32_t g = (endpoints[i] >> 5) & 63;
+			const int32_t b = endpoints[i] & 31;
+			palette[i][0] = (r << 3) | (r >> 2);
+			palette[i][1] = (g << 2) | (g >> 4);
+			palette[i][2] = (b << 3) | (b >> 2);
+			palette[i][3] = 255;
+		}
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			if (c0 > c1)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[2][3] = 255;
+		palette[3][3] = c0 > c1 ? 255 : 0;
+	}
+
+	// Texel of a tile with its channels in [0, 255]
+	inline __m128 fetchTexel(TileEncoding encoding, const uint8_t *tile, int32_t tileSize, int32_t x, int32_t y)
+	{
+		if (encoding == TileEncoding::Rgba8)
+		{
+			int32_t packed;
+			std::memcpy(&packed, &tile[(x + y * tileSize) * 4], sizeof(packed));
+			const __m128i zero = _mm_setzero_si128();
+			__m128i texel = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+			return (_mm_cvtepi32_ps(_mm_unpacklo_epi16(texel, zero)));
+		}
+		else if (encoding == TileEncoding::Half)
+		{
+			uint16_t halves[4];
+			std::memcpy(halves, &tile[(x + y * tileSize) * 8], sizeof(halves));
+			return (_mm_mul_ps(_mm_setr_ps(fromHalf(halves[0]), fromHalf(halves[1]), fromHalf(halves[2]), fromHalf(halves[3])), _mm_set1_ps(255.f)));
+		}
+
+		const uint8_t *block = &tile[(x / 4 + (y / 4) * (tileSize / 4)) * 8];
+		uint16_t c0;
+		uint16_t c1;
+		uint32_t indices;
+		std::memcpy(&c0, block, sizeof(c0));
+		std::memcpy(&c1, block + 2, sizeof(c1));
+		std::memcpy(&indices, block + 4, sizeof(indices));
+		int32_t palette[4][4];
+		decodeBc1Palette(c0, c1, palette);
+		const uint32_t index = (indices >> (2 * ((x % 4) + (y % 4) * 4))) & 3;
+		return (_mm_cvtepi32_ps(_mm_setr_epi32(palette[index][0], palette[index][1], palette[index][2], palette[index][3])));
+	}
+
+	// Read-only mapping of a .atx file
+	class TextureFile
+	{
+	public:
+		static constexpr int32_t DefaultTileSize = 64;
+
+		TextureFile() = default;
+		TextureFile(const TextureFile &) = delete;
+		TextureFile &operator=(const TextureFile &) = delete;
+		ATLAS_SH ~TextureFile();
+
+		ATLAS_SH bool open(const std::string &filename);
+		ATLAS_SH void close();
+
+		inline const TextureFileHeader &getHeader() const
+		{
+			return (*header);
+		}
+
+		inline const TextureFileLevel &getLevel(uint32_t level) const
+		{
+			return (levels[level]);
+		}
+
+		inline const uint8_t *getTile(uint32_t tile) const
+		{
+			return (data + header->dataOffset + tile * tileBytes);
+		}
+
+		inline size_t getTileBytes() const
+		{
+			return (tileBytes);
+		}
+
+		// Builds the mip pyramid of an image readable by stb_image and writes it as a .atx file
+		ATLAS_SH static bool convert(const std::string &src, const std::string &dst, TileEncoding encoding);
+
+	private:
+		void *file = nullptr;
+		void *mapping = nullptr;
+		const uint8_t *data = nullptr;
+		size_t size = 0;
+
+		const TextureFileHeader *header = nullptr;
+		const TextureFileLevel *levels = nullptr;
+		size_t tileBytes = 0;
+
+		bool isValid() const;
+	};
+}
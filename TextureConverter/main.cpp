@@ -0,0 +1,35 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "TextureFile.h"
+
+int main(int ac, char **av)
+{
+	if (ac < 3)
+	{
+		std::cout << "usage: " << av[0] << " <input image> <output.atx> [rgba8|half|bc1]" << std::endl;
+		return (1);
+	}
+
+	atlas::TileEncoding encoding = atlas::TileEncoding::Rgba8;
+	if (ac > 3)
+	{
+		if (std::strcmp(av[3], "half") == 0)
+			encoding = atlas::TileEncoding::Half;
+		else if (std::strcmp(av[3], "bc1") == 0)
+			encoding = atlas::TileEncoding::Bc1;
+		else if (std::strcmp(av[3], "rgba8") != 0)
+		{
+			std::cout << "unknown encoding " << av[3] << std::endl;
+			return (1);
+		}
+	}
+
+	if (!atlas::TextureFile::convert(av[1], av[2], encoding))
+	{
+		std::cout << "failed to convert " << av[1] << std::endl;
+		return (1);
+	}
+	return (0);
+}